@@ -6,6 +6,8 @@
 #include <iostream>
 #include "CentroidDecomposition.h"
 #include "Auxiliary.h"
+#include "Kernels.h"
+#include "GramCache.h"
 
 namespace Algorithms
 {
@@ -21,26 +23,25 @@ CentroidDecomposition::CentroidDecomposition(arma::mat &mx, uint64_t k)
         : Src(mx),
           Load(mx.n_rows, k),
           Rel(mx.n_cols, k),
-          signVectors(std::vector<arma::vec>()),
+          signVectors(std::vector<Algebra::SignVector>()),
           truncation(k),
           strategy(defaultSignVectorStrategy)
 {
     Load.zeros();
     Rel.zeros();
     
-    // i = 0:
-    arma::vec signV(mx.n_rows);
-    signV.fill(1.0);
-    signVectors.emplace_back(std::move(signV));
-
+    // i in [0,m[
+    for (uint64_t i = 0; i < mx.n_cols; ++i)
+    {
+        signVectors.emplace_back(mx.n_rows);
+    }
+    
     arma::vec direction(mx.n_cols);
     direction.fill(0.0);
     directions.emplace_back(std::move(direction));
     
-    // i in [1,m[
     for (uint64_t i = 1; i < mx.n_cols; ++i)
     {
-        signVectors.emplace_back(signVectors[0]);
         directions.emplace_back(directions[0]);
     }
 }
@@ -66,6 +67,7 @@ arma::mat CentroidDecomposition::stealLoad()
 
 arma::mat CentroidDecomposition::stealRel()
 {
+    relGram.reset();
     return std::move(Rel);
 }
 
@@ -73,6 +75,7 @@ void CentroidDecomposition::destroyDecomposition()
 {
     Load.zeros();
     Rel.zeros();
+    relGram.reset();
 }
 
 void CentroidDecomposition::changeTruncation(uint64_t _k)
@@ -80,35 +83,74 @@ void CentroidDecomposition::changeTruncation(uint64_t _k)
     truncation = _k;
     Load.resize(Load.n_rows, _k);
     Rel.resize(Rel.n_rows, _k);
+    relGram.reset();
 }
 
 void CentroidDecomposition::resetSignVectors()
 {
     for (uint64_t i = 0; i < Src.n_cols; ++i)
     {
-        for (uint64_t j = 0; j < Src.n_rows; j++)
-        {
-            signVectors[i][j] = 1.0;
-        }
+        signVectors[i].reset();
     }
 }
 
 void CentroidDecomposition::performDecomposition(std::vector<double> *centroidValues,
-                                                 bool stopOnIncompleteRank /*= false*/, bool skipSSV /*= false*/)
+                                                 bool stopOnIncompleteRank /*= false*/, bool skipSSV /*= false*/,
+                                                 uint64_t rows /*= 0*/)
 {
-    arma::mat X(Src);
+    uint64_t outside = rows > 0 && rows < Src.n_rows ? Src.n_rows - rows : 0;
+    addedRows = addedRows > outside ? addedRows - outside : 0; // the rows left out are the newest ones
+    
+    // budgets of the sign vector search are shared by all the components
+    sweeps = 0;
+    flips = 0;
+    deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeBudget);
+    searchTruncated = false;
+    
+    // implicit deflation: X_i is never materialized, products with it are taken on Src and corrected by the components
+    // that are already extracted; only LSV is able to work without the rows of X_i at hand
+    bool implicit = implicitDeflation && outside == 0
+                    && (strategy == CDSignVectorStrategy_2::LSVBase || strategy == CDSignVectorStrategy_2::LSVNoInit);
+    
+    // working copy is kept transposed: row X_i* is the contiguous column Xt_*i, which is what SSV scans over
+    arma::mat Xt = implicit
+                   ? arma::mat()
+                   : outside > 0 ? arma::mat(Src.rows(0, Src.n_rows - outside - 1).t()) : arma::mat(Src.t());
+    
+    if (implicit)
+    {
+        // (||Src_i*||_2)^2, column by column
+        srcRowNorms.zeros(Src.n_rows);
+        
+        for (uint64_t j = 0; j < Src.n_cols; ++j)
+        {
+            for (uint64_t i = 0; i < Src.n_rows; ++i)
+            {
+                srcRowNorms[i] += Src.at(i, j) * Src.at(i, j);
+            }
+        }
+    }
     
     for (uint64_t i = 0; i < truncation; i++)
     {
-        arma::vec &Z = skipSSV
+        Algebra::SignVector &Z = skipSSV
                     ? signVectors[i]
-                    : findSignVector(X, i);
+                    : implicit
+                      ? findImplicitSignVector(i, strategy == CDSignVectorStrategy_2::LSVBase || outOfBudget())
+                      : findSignVector(Xt, i);
         
         //std::cout << Z.toString() << std::endl;
-
+        
         if (!decomposed && skipSSV)
         {
-            directions[i] = (X.t() * Z);
+            if (implicit)
+            {
+                implicitSignedRowSum(i, Z, directions[i]);
+            }
+            else
+            {
+                signedRowSum(Xt, Z, directions[i]);
+            }
         }
         
         // C_*i = X^T * Z, cached by SSV search
@@ -132,17 +174,37 @@ void CentroidDecomposition::performDecomposition(std::vector<double> *centroidVa
         Algebra::Operations::insert_vector_at_column(Rel, i, Rel_i);
         
         // L_*i = X * R
-        arma::vec Load_i = X * Rel_i;
+        // X := X - L_*i * R_*i^T
+        arma::vec Load_i(Src.n_rows);
+        
+        if (implicit)
+        {
+            implicitProduct(i, Rel_i, Load_i);
+        }
+        else
+        {
+            deflate(Xt, Rel_i, Load_i);
+            Load_i.resize(Src.n_rows);
+            
+            for (uint64_t r = Src.n_rows - outside; r < Src.n_rows; ++r)
+            {
+                Load_i[r] = 0.0;
+            }
+        }
         
         // L = Append(L, L_*i)
         Algebra::Operations::insert_vector_at_column(Load, i, Load_i);
-        
-        // X := X - L_*i * R_*i^T
-        X -= (Load_i * Rel_i.t());
     }
     
-    addedRows = 0;
+    addedRows = outside;
     decomposed = true;
+    srcRowNorms.reset();
+    relGram.reset();
+    
+    if (searchTruncated)
+    {
+        ++truncatedSearches;
+    }
 }
 
 //
@@ -157,7 +219,7 @@ void CentroidDecomposition::increment(const arma::vec &vec)
     
     for (uint64_t i = 0; i < Src.n_cols; ++i)
     {
-        Algebra::Operations::increment_vector(signVectors[i], 1.0);
+        signVectors[i].append(1);
     }
 }
 
@@ -173,49 +235,561 @@ void CentroidDecomposition::increment_raw(uint64_t newrows)
     
     addedRows += newrows;
     
+    for (uint64_t i = 0; i < Src.n_cols; ++i)
+    {
+        signVectors[i].append(newrows);
+    }
+}
+
+// Streaming: a single row is decomposed against the current Rel, without revisiting the other rows.
+// Row i of X_k (deflated matrix) is obtained as Src_i* - Sum(l<k) { L_il * R_*l^T }, which is what
+// the batch deflation would produce for this row given the same Rel.
+
+void CentroidDecomposition::projectRow(uint64_t i)
+{
+    arma::vec x = Src.row(i).t();
+    
+    for (uint64_t k = 0; k < truncation; ++k)
+    {
+        // L_ik = X_i* * R_*k
+        double load = arma::dot(x, Rel.col(k));
+        Load.at(i, k) = load;
+        
+        // X_i* := X_i* - L_ik * R_*k^T
+        x -= load * Rel.col(k);
+    }
+}
+
+// Rel stays as it is until the next full decomposition (refreshing it from a single row breaks the orthogonality
+// w.r.t. the rows that are already deflated), but sign vectors and cached directions absorb the row, so the next
+// full decomposition starts from a sign vector that already accounts for it.
+
+void CentroidDecomposition::commitRow(uint64_t i)
+{
+    arma::vec x = Src.row(i).t();
+    
+    for (uint64_t k = 0; k < truncation; ++k)
+    {
+        arma::vec &direction = directions[k];
+        
+        // z_i is chosen to maximize ||C_*k + z_i * X_i*^T||, which boils down to the sign of <C_*k, X_i*>
+        double sign = arma::dot(direction, x) >= 0.0 ? 1.0 : -1.0;
+        signVectors[k].set(i, sign);
+        direction += sign * x;
+        
+        double load = arma::dot(x, Rel.col(k));
+        Load.at(i, k) = load;
+        
+        x -= load * Rel.col(k);
+    }
+    
+    // rows are committed in arrival order, the ones left behind are still treated as new by SSV
+    if (addedRows > 0 && i == Src.n_rows - addedRows)
+    {
+        --addedRows;
+    }
+}
+
+// Inverse of commitRow: the contribution of the row is taken out of the cached directions, so the row can leave
+// the decomposition without touching the others.
+
+void CentroidDecomposition::retractRow(uint64_t i)
+{
+    arma::vec x = Src.row(i).t();
+    
+    for (uint64_t k = 0; k < truncation; ++k)
+    {
+        directions[k] -= signVectors[k][i] * x;
+        signVectors[k].set(i, 1.0);
+        
+        x -= arma::dot(x, Rel.col(k)) * Rel.col(k);
+        Load.at(i, k) = 0.0;
+    }
+}
+
+// Fold-in: the loads of a row are fitted on its observed entries alone, so the missing ones don't pull the loads
+// towards their initial values and no iterations are needed. R_obs^T * R_obs is the cached Rel^T * Rel with the rows
+// of the missing entries taken out, O(m * k + |missing| * k^2 + k^3) per row.
+
+bool CentroidDecomposition::foldInRow(uint64_t i, const std::vector<uint64_t> &missing, double &residual)
+{
+    uint64_t k = truncation;
+    
+    if (Src.n_cols < missing.size() + k)
+    {
+        return false;
+    }
+    
+    if (relGram.n_rows != k)
+    {
+        relGram = Rel.t() * Rel;
+    }
+    
+    arma::mat gram = relGram;
+    
+    for (uint64_t j : missing)
+    {
+        for (uint64_t a = 0; a < k; ++a)
+        {
+            for (uint64_t b = 0; b < k; ++b)
+            {
+                gram.at(a, b) -= Rel.at(j, a) * Rel.at(j, b);
+            }
+        }
+    }
+    
+    // R_obs^T * x_obs
+    arma::vec rhs(k);
+    rhs.zeros();
+    
+    auto next = missing.begin();
+    
+    for (uint64_t j = 0; j < Src.n_cols; ++j)
+    {
+        if (next != missing.end() && *next == j)
+        {
+            ++next;
+            continue;
+        }
+        
+        for (uint64_t a = 0; a < k; ++a)
+        {
+            rhs[a] += Src.at(i, j) * Rel.at(j, a);
+        }
+    }
+    
+    arma::vec load;
+    
+    // gram comes out of relGram by subtraction, an exactly singular system is left with rounding noise in it that
+    // solve() would take as a valid one
+    if (arma::rcond(gram) < eps || !arma::solve(load, gram, rhs))
+    {
+        return false;
+    }
+    
+    double error = 0.0;
+    double norm = 0.0;
+    next = missing.begin();
+    
     for (uint64_t j = 0; j < Src.n_cols; ++j)
     {
-        signVectors[j].resize(signVectors[j].n_elem + newrows);
+        if (next != missing.end() && *next == j)
+        {
+            ++next;
+            continue;
+        }
+        
+        double fit = 0.0;
         
-        for (uint64_t i = signVectors[j].n_rows - newrows; i < signVectors[j].n_rows; ++i)
+        for (uint64_t a = 0; a < k; ++a)
         {
-            signVectors[j][i] = 1.0;
+            fit += load[a] * Rel.at(j, a);
         }
+        
+        error += (Src.at(i, j) - fit) * (Src.at(i, j) - fit);
+        norm += Src.at(i, j) * Src.at(i, j);
     }
+    
+    residual = norm > 0.0 ? std::sqrt(error / norm) : 0.0;
+    
+    for (uint64_t a = 0; a < k; ++a)
+    {
+        Load.at(i, a) = load[a];
+    }
+    
+    return true;
+}
+
+// Sliding window: Src is used as a ring buffer of at most <capacity> rows, windowHead points to the oldest one.
+
+void CentroidDecomposition::setWindow(uint64_t capacity)
+{
+    if (capacity > 0 && capacity < Src.n_rows)
+    {
+        throw std::runtime_error("window capacity can't be smaller than the amount of rows already in the matrix");
+    }
+    
+    window = capacity;
+    windowHead = 0;
+}
+
+uint64_t CentroidDecomposition::getWindow() const
+{
+    return window;
+}
+
+uint64_t CentroidDecomposition::getWindowHead() const
+{
+    return windowHead;
+}
+
+uint64_t CentroidDecomposition::getFlips() const
+{
+    return flips;
+}
+
+void CentroidDecomposition::centroidSpectrum(std::vector<double> &centroidValues)
+{
+    arma::mat Xt = Src.t();
+    arma::vec direction;
+    arma::vec Load_i(Src.n_rows);
+    
+    for (uint64_t i = 0; i < Src.n_cols; ++i)
+    {
+        signedRowSum(Xt, signVectors[i], direction);
+        double centroid = arma::norm(direction);
+        
+        if (centroid < eps)
+        {
+            break;
+        }
+        
+        centroidValues.emplace_back(centroid);
+        deflate(Xt, direction / centroid, Load_i);
+    }
+}
+
+uint64_t CentroidDecomposition::slideWindow()
+{
+    // not full yet (or unbounded) - grow by a row
+    if (window == 0 || Src.n_rows < window)
+    {
+        increment_raw(1);
+        return Src.n_rows - 1;
+    }
+    
+    // full - the oldest row leaves and its slot is reused
+    uint64_t slot = windowHead;
+    retractRow(slot);
+    windowHead = (windowHead + 1) % window;
+    
+    return slot;
+}
+
+// The ring is rotated so the oldest row is row 0 again, rows keep the order they arrived in. O(n * (m + k)).
+uint64_t CentroidDecomposition::unrollWindow()
+{
+    uint64_t shift = windowHead;
+    uint64_t n = Src.n_rows;
+    
+    if (shift == 0)
+    {
+        return 0;
+    }
+    
+    arma::mat src(n, Src.n_cols);
+    arma::mat load(n, Load.n_cols);
+    
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        uint64_t from = (i + shift) % n;
+        
+        for (uint64_t j = 0; j < Src.n_cols; ++j)
+        {
+            src.at(i, j) = Src.at(from, j);
+        }
+        
+        for (uint64_t j = 0; j < Load.n_cols && from < Load.n_rows; ++j)
+        {
+            load.at(i, j) = Load.at(from, j);
+        }
+    }
+    
+    Src = std::move(src);
+    
+    if (Load.n_rows == n)
+    {
+        Load = std::move(load);
+    }
+    
+    for (Algebra::SignVector &Z : signVectors)
+    {
+        Algebra::SignVector rotated(Z.size());
+        
+        for (uint64_t i = 0; i < Z.size(); ++i)
+        {
+            rotated.set(i, Z[(i + shift) % Z.size()]);
+        }
+        
+        Z = std::move(rotated);
+    }
+    
+    windowHead = 0;
+    return shift;
+}
+
+void CentroidDecomposition::saveState(MathIO::CheckpointWriter &writer) const
+{
+    writer.write(truncation);
+    writer.write((uint64_t)strategy);
+    writer.write((uint64_t)decomposed);
+    writer.write(addedRows);
+    writer.write(window);
+    writer.write(windowHead);
+    
+    writer.write(Load);
+    writer.write(Rel);
+    
+    writer.write((uint64_t)signVectors.size());
+    for (const Algebra::SignVector &Z : signVectors)
+    {
+        writer.write((uint64_t)Z.size());
+        writer.write(Z.data(), ((Z.size() + 63) / 64) * sizeof(uint64_t));
+    }
+    
+    writer.write((uint64_t)directions.size());
+    for (const arma::vec &direction : directions)
+    {
+        writer.write(direction);
+    }
+}
+
+void CentroidDecomposition::loadState(MathIO::CheckpointReader &reader)
+{
+    truncation = reader.readWord();
+    uint64_t code = reader.readWord();
+    
+    if (code > (uint64_t)CDSignVectorStrategy_2::LSVNoInit || !isValidStrategy_2((CDSignVectorStrategy_2)code))
+    {
+        throw std::runtime_error("checkpoint has an unknown sign vector strategy");
+    }
+    
+    strategy = (CDSignVectorStrategy_2)code;
+    decomposed = reader.readWord() != 0;
+    addedRows = reader.readWord();
+    window = reader.readWord();
+    windowHead = reader.readWord();
+    
+    reader.read(Load);
+    reader.read(Rel);
+    relGram.reset();
+    
+    if (decomposed && (Load.n_rows != Src.n_rows || Rel.n_rows != Src.n_cols))
+    {
+        throw std::runtime_error("checkpoint doesn't match the dimensions of the matrix");
+    }
+    
+    // a sign vector takes at least its length word, a direction its two dimensions
+    signVectors.resize(reader.readLength(sizeof(uint64_t)));
+    for (Algebra::SignVector &Z : signVectors)
+    {
+        Z = Algebra::SignVector(reader.readLength(sizeof(uint64_t), 64));
+        reader.read(Z.data(), ((Z.size() + 63) / 64) * sizeof(uint64_t));
+    }
+    
+    directions.resize(reader.readLength(2 * sizeof(uint64_t)));
+    for (arma::vec &direction : directions)
+    {
+        reader.read(direction);
+    }
+}
+
+void CentroidDecomposition::swapState(CentroidDecomposition &other)
+{
+    std::swap(truncation, other.truncation);
+    std::swap(strategy, other.strategy);
+    std::swap(decomposed, other.decomposed);
+    std::swap(addedRows, other.addedRows);
+    std::swap(window, other.window);
+    std::swap(windowHead, other.windowHead);
+    
+    Load.swap(other.Load);
+    Rel.swap(other.Rel);
+    relGram.reset();
+    other.relGram.reset();
+    
+    signVectors.swap(other.signVectors);
+    directions.swap(other.directions);
 }
 
 //
 // Algorithm
 //
 
-arma::vec &CentroidDecomposition::findSignVector(arma::mat &mx, uint64_t k)
+// One pass, each row takes the sign that makes ||D|| grow the most given the rows before it
+void CentroidDecomposition::greedySignVector(const arma::mat &Xt, Algebra::SignVector &Z, double *direction)
+{
+    const double *x0 = Xt.colptr(0);
+    
+    Z.set(0, 1.0);
+    
+    for (uint64_t j = 0; j < Xt.n_rows; ++j)
+    {
+        direction[j] = x0[j];
+    }
+    
+    for (uint64_t i = 1; i < Xt.n_cols; ++i)
+    {
+        const double *x = Xt.colptr(i);
+        
+        // ||D + X_i*||^2 - ||D - X_i*||^2 = 4 * <D, X_i*>
+        Z.set(i, Algebra::Kernels::dot(direction, x, Xt.n_rows) > 0.0 ? 1 : -1);
+        
+        Algebra::Kernels::axpy(Z[i], x, direction, Xt.n_rows);
+    }
+}
+
+// Checked before every sweep and every flip. Once a budget runs out, the searches return the sign vectors as they
+// are; directions stay consistent with them, the decomposition is just less optimal.
+bool CentroidDecomposition::outOfBudget()
+{
+    if (!searchTruncated)
+    {
+        searchTruncated = (maxSweeps > 0 && sweeps >= maxSweeps)
+                          || (maxFlips > 0 && flips >= maxFlips)
+                          || (timeBudget > 0 && std::chrono::steady_clock::now() >= deadline);
+    }
+    
+    return searchTruncated;
+}
+
+// D = X^T * Z
+void CentroidDecomposition::signedRowSum(const arma::mat &Xt, const Algebra::SignVector &Z, arma::vec &direction)
+{
+    if (threads <= 1)
+    {
+        direction.zeros(Xt.n_rows);
+        
+        for (uint64_t i = 0; i < Xt.n_cols; ++i)
+        {
+            Algebra::Kernels::axpy(Z[i], Xt.colptr(i), direction.memptr(), Xt.n_rows);
+        }
+        
+        return;
+    }
+    
+    // partial sums over fixed blocks of rows, added up in block order - same result for any amount of threads
+    uint64_t blocks = (Xt.n_cols + parallelBlock - 1) / parallelBlock;
+    arma::mat partial(Xt.n_rows, blocks);
+    
+    #pragma omp parallel for num_threads(threads) schedule(static)
+    for (uint64_t b = 0; b < blocks; ++b)
+    {
+        double *sum = partial.colptr(b);
+        std::fill(sum, sum + Xt.n_rows, 0.0);
+        
+        for (uint64_t i = b * parallelBlock; i < std::min<uint64_t>((b + 1) * parallelBlock, Xt.n_cols); ++i)
+        {
+            Algebra::Kernels::axpy(Z[i], Xt.colptr(i), sum, Xt.n_rows);
+        }
+    }
+    
+    direction.zeros(Xt.n_rows);
+    
+    for (uint64_t b = 0; b < blocks; ++b)
+    {
+        Algebra::Kernels::axpy(1.0, partial.colptr(b), direction.memptr(), Xt.n_rows);
+    }
+}
+
+// L_*i = X * R_*i; X := X - L_*i * R_*i^T
+void CentroidDecomposition::deflate(arma::mat &Xt, const arma::vec &Rel_i, arma::vec &Load_i)
+{
+    if (threads <= 1)
+    {
+        Load_i = Xt.t() * Rel_i;
+        Xt -= (Rel_i * Load_i.t());
+        return;
+    }
+    
+    // every row is deflated on its own
+    #pragma omp parallel for num_threads(threads) schedule(static)
+    for (uint64_t i = 0; i < Xt.n_cols; ++i)
+    {
+        Load_i[i] = Algebra::Kernels::dot(Xt.colptr(i), Rel_i.memptr(), Xt.n_rows);
+        Algebra::Kernels::axpy(-Load_i[i], Rel_i.memptr(), Xt.colptr(i), Xt.n_rows);
+    }
+}
+
+// Implicit deflation: X_k = Src - Sum(l<k) { L_*l * R_*l^T }
+
+// X_k_i* = Src_i* - Sum(l<k) { L_il * R_*l^T }
+void CentroidDecomposition::implicitRow(uint64_t i, uint64_t k, arma::vec &x)
+{
+    for (uint64_t j = 0; j < Src.n_cols; ++j)
+    {
+        x[j] = Src.at(i, j);
+    }
+    
+    for (uint64_t l = 0; l < k; ++l)
+    {
+        Algebra::Kernels::axpy(-Load.at(i, l), Rel.colptr(l), x.memptr(), Src.n_cols);
+    }
+}
+
+// X_k * v = Src * v - Sum(l<k) { L_*l * <R_*l, v> }
+void CentroidDecomposition::implicitProduct(uint64_t k, const arma::vec &v, arma::vec &res)
+{
+    res = Src * v;
+    
+    for (uint64_t l = 0; l < k; ++l)
+    {
+        double c = Algebra::Kernels::dot(Rel.colptr(l), v.memptr(), Src.n_cols);
+        Algebra::Kernels::axpy(-c, Load.colptr(l), res.memptr(), Src.n_rows);
+    }
+}
+
+// X_k^T * Z = Src^T * Z - Sum(l<k) { R_*l * <L_*l, Z> }
+void CentroidDecomposition::implicitSignedRowSum(uint64_t k, const Algebra::SignVector &Z, arma::vec &direction)
+{
+    direction.set_size(Src.n_cols);
+    
+    for (uint64_t j = 0; j < Src.n_cols; ++j)
+    {
+        direction[j] = Z.dot(Src.colptr(j));
+    }
+    
+    for (uint64_t l = 0; l < k; ++l)
+    {
+        double c = Z.dot(Load.colptr(l));
+        Algebra::Kernels::axpy(-c, Rel.colptr(l), direction.memptr(), Src.n_cols);
+    }
+}
+
+Algebra::SignVector &CentroidDecomposition::findSignVector(arma::mat &Xt, uint64_t k)
 {
+    // out of budget before the search even started: a sign vector of a previous decomposition is reused as it is,
+    // otherwise one greedy pass is made, which costs about as much as X_k^T * {+1}^n and is a far better start
+    if (outOfBudget())
+    {
+        if (decomposed)
+        {
+            signedRowSum(Xt, signVectors[k], directions[k]);
+        }
+        else
+        {
+            greedySignVector(Xt, signVectors[k], directions[k].memptr());
+        }
+        
+        return signVectors[k];
+    }
+    
     switch (strategy)
     {
         case CDSignVectorStrategy_2::ISSVBase:
-            return findIncrementalSSV(mx, k);
+            return findIncrementalSSV(Xt, k);
         
         case CDSignVectorStrategy_2::ISSVPlusBase:
-            return findIncrementalSSVPlus(mx, k);
+            return findIncrementalSSVPlus(Xt, k);
         
         case CDSignVectorStrategy_2::ISSVInit:
         case CDSignVectorStrategy_2::ISSVPlusInit:
-            return findOptimizedSSV(mx, k);
+            return findOptimizedSSV(Xt, k);
         
         case CDSignVectorStrategy_2::LSVBase:
-            return findLocalSignVector(mx, k, true);
+            return findLocalSignVector(Xt, k, true);
         
         case CDSignVectorStrategy_2::LSVNoInit:
-            return findLocalSignVector(mx, k, false);
-    
+            return findLocalSignVector(Xt, k, false);
+        
         default:
             throw std::runtime_error("invalid strategy");
     }
 }
 
-arma::vec &CentroidDecomposition::findLocalSignVector(arma::mat &mx, uint64_t k, bool useInit)
+Algebra::SignVector &CentroidDecomposition::findLocalSignVector(arma::mat &Xt, uint64_t k, bool useInit)
 {
-    arma::vec &Z = signVectors[k]; // get a reference
+    Algebra::SignVector &Z = signVectors[k]; // get a reference
     arma::vec &direction = directions[k];
     
     //
@@ -223,217 +797,389 @@ arma::vec &CentroidDecomposition::findLocalSignVector(arma::mat &mx, uint64_t k,
     //
     if (!decomposed && useInit)
     {
-        for (uint64_t j = 0; j < mx.n_cols; ++j)
+        greedySignVector(Xt, Z, direction.memptr());
+    }
+    else // Alternative first pass - init to {+1}^n
+    {
+        signedRowSum(Xt, Z, direction);
+    }
+    
+    //
+    // 2+ pass - update to Z
+    //
+    
+    // special step - check for increment, assume Z is incremented by {+1}^AR
+    if (addedRows > 0)
+    {
+        for (uint64_t i = Xt.n_cols - addedRows; i < Xt.n_cols; ++i)
         {
-            direction[j] = mx.at(0, j);
+            direction += Xt.col(i);
         }
+    }
+    
+    // (||X_i*||_2)^2 don't change during the search, gains of a flip are computed in closed form from them
+    std::vector<double> rowNorms(Xt.n_cols);
+    
+    #pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+    for (uint64_t i = 0; i < Xt.n_cols; ++i)
+    {
+        rowNorms[i] = Algebra::Kernels::dot(Xt.colptr(i), Xt.colptr(i), Xt.n_rows);
+    }
+    
+    bool flipped;
+    
+    if (threads > 1)
+    {
+        // <D, X_i*> of all rows are evaluated in parallel against the same D, then flips are committed serially in row
+        // order; after the first flip of a sweep D is not the same anymore, so every row after it is evaluated again
+        // against the current D, stale values can't be used even to skip a row. The flips are the ones of the serial
+        // search, for any amount of threads.
+        std::vector<double> dots(Xt.n_cols);
         
-        for (uint64_t i = 1; i < mx.n_rows; ++i)
+        do
         {
-            double gradPlus = 0.0;
-            double gradMinus = 0.0;
+            if (outOfBudget())
+            {
+                break;
+            }
             
-            for (uint64_t j = 0; j < mx.n_cols; ++j)
+            ++sweeps;
+            flipped = false;
+            
+            double lastNorm = arma::dot(direction, direction) + eps;
+            
+            #pragma omp parallel for num_threads(threads) schedule(static)
+            for (uint64_t i = 0; i < Xt.n_cols; ++i)
             {
-                double localModPlus = direction[j] + mx.at(i, j);
-                gradPlus += localModPlus * localModPlus;
-                double localModMinus = direction[j] - mx.at(i, j);
-                gradMinus += localModMinus * localModMinus;
+                dots[i] = Algebra::Kernels::dot(direction.memptr(), Xt.colptr(i), Xt.n_rows);
             }
             
-            // if keeping +1 as a sign yields a net negative to the
-            Z[i] = gradPlus > gradMinus ? 1 : -1;
+            for (uint64_t i = 0; i < Xt.n_cols; ++i)
+            {
+                if (flipped) // stale
+                {
+                    dots[i] = Algebra::Kernels::dot(direction.memptr(), Xt.colptr(i), Xt.n_rows);
+                }
+                
+                double signDouble = Z[i] * 2;
+                double gradFlip = (lastNorm - eps) - 2.0 * signDouble * dots[i] + 4.0 * rowNorms[i];
+                
+                if (gradFlip <= lastNorm)
+                {
+                    continue;
+                }
+                
+                if (outOfBudget())
+                {
+                    break;
+                }
+                
+                ++flips;
+                flipped = true;
+                Z.flip(i);
+                lastNorm = gradFlip + eps;
+                
+                Algebra::Kernels::axpy(-signDouble, Xt.colptr(i), direction.memptr(), Xt.n_rows);
+            }
+        } while (flipped);
+        
+        return Z;
+    }
+    
+    do
+    {
+        if (outOfBudget())
+        {
+            break;
+        }
+        
+        ++sweeps;
+        flipped = false;
+        
+        double lastNorm = // cache the current value of (||D||_2)^2 to avoid recalcs, refreshed every sweep
+                arma::dot(direction, direction) + eps; // eps to avoid "parity flip"
+        
+        for (uint64_t i = 0; i < Xt.n_cols; ++i)
+        {
+            const double *x = Xt.colptr(i);
+            double signDouble = Z[i] * 2;
+            
+            // ||D - 2 * z_i * X_i*||^2 = ||D||^2 - 4 * z_i * <D, X_i*> + 4 * ||X_i*||^2
+            double gradFlip = (lastNorm - eps)
+                              - 2.0 * signDouble * Algebra::Kernels::dot(direction.memptr(), x, Xt.n_rows)
+                              + 4.0 * rowNorms[i];
             
-            for (uint64_t j = 0; j < mx.n_cols; ++j)
+            if (gradFlip > lastNorm) // net positive from flipping
             {
-                direction[j] += Z[i] * mx.at(i, j);
+                if (outOfBudget())
+                {
+                    break;
+                }
+                
+                ++flips;
+                flipped = true;
+                Z.flip(i);
+                lastNorm = gradFlip + eps;
+                
+                Algebra::Kernels::axpy(-signDouble, x, direction.memptr(), Xt.n_rows);
             }
         }
+    } while (flipped);
+    
+    return Z;
+}
+
+// Same search as LSV, but a sweep evaluates <D, X_i*> for all rows at once as X_k * D, then flips are committed in
+// row order (see the parallel LSV). Rows are only materialized for the flips themselves.
+Algebra::SignVector &CentroidDecomposition::findImplicitSignVector(uint64_t k, bool useInit)
+{
+    Algebra::SignVector &Z = signVectors[k]; // get a reference
+    arma::vec &direction = directions[k];
+    arma::vec x(Src.n_cols);
+    
+    //
+    // First pass - init
+    //
+    if (!decomposed && useInit)
+    {
+        implicitRow(0, k, x);
+        direction = x;
+        
+        for (uint64_t i = 1; i < Src.n_rows; ++i)
+        {
+            implicitRow(i, k, x);
+            Z.set(i, Algebra::Kernels::dot(direction.memptr(), x.memptr(), Src.n_cols) > 0.0 ? 1 : -1);
+            
+            Algebra::Kernels::axpy(Z[i], x.memptr(), direction.memptr(), Src.n_cols);
+        }
     }
     else // Alternative first pass - init to {+1}^n
     {
-        direction = (mx.t() * Z);
+        implicitSignedRowSum(k, Z, direction);
     }
     
     //
     // 2+ pass - update to Z
     //
-
+    
     // special step - check for increment, assume Z is incremented by {+1}^AR
     if (addedRows > 0)
     {
-        for (uint64_t i = mx.n_rows - addedRows; i < mx.n_rows; ++i)
+        for (uint64_t i = Src.n_rows - addedRows; i < Src.n_rows; ++i)
         {
-            direction += mx.row(i).t();
+            implicitRow(i, k, x);
+            direction += x;
         }
     }
     
+    // (||X_i*||_2)^2 = (||Src_i*||_2)^2 - Sum(l<k) { L_il^2 }, R being orthonormal; cancellation can take a row that is
+    // deflated to (almost) 0 below that
+    arma::vec rowNorms = srcRowNorms;
+    
+    for (uint64_t l = 0; l < k; ++l)
+    {
+        for (uint64_t i = 0; i < Src.n_rows; ++i)
+        {
+            rowNorms[i] -= Load.at(i, l) * Load.at(i, l);
+        }
+    }
+    
+    for (uint64_t i = 0; i < Src.n_rows; ++i)
+    {
+        rowNorms[i] = std::max(rowNorms[i], 0.0);
+    }
+    
+    arma::vec dots(Src.n_rows);
     bool flipped;
-    double lastNorm = // cache the current value of (||D||_2)^2 to avoid recalcs
-            arma::dot(direction, direction) + eps; // eps to avoid "parity flip"
     
     do
     {
+        if (outOfBudget())
+        {
+            break;
+        }
+        
+        ++sweeps;
         flipped = false;
         
-        for (uint64_t i = 0; i < mx.n_rows; ++i)
+        double lastNorm = arma::dot(direction, direction) + eps;
+        
+        // <D, X_i*> against the D of the start of the sweep; after the first flip they are stale, every row after it is
+        // evaluated again against the current D
+        implicitProduct(k, direction, dots);
+        
+        for (uint64_t i = 0; i < Src.n_rows; ++i)
         {
+            if (flipped) // stale
+            {
+                implicitRow(i, k, x);
+                dots[i] = Algebra::Kernels::dot(direction.memptr(), x.memptr(), Src.n_cols);
+            }
+            
             double signDouble = Z[i] * 2;
-            double gradFlip = 0.0;
+            double gradFlip = (lastNorm - eps) - 2.0 * signDouble * dots[i] + 4.0 * rowNorms[i];
             
-            for (uint64_t j = 0; j < mx.n_cols; ++j)
+            if (gradFlip <= lastNorm)
             {
-                double localMod = direction[j] - signDouble * mx.at(i, j);
-                gradFlip += localMod * localMod;
+                continue;
             }
             
-            if (gradFlip > lastNorm) // net positive from flipping
+            if (!flipped)
             {
-                flipped = true;
-                Z[i] *= -1;
-                lastNorm = gradFlip + eps;
-                
-                for (uint64_t j = 0; j < mx.n_cols; ++j)
-                {
-                    direction[j] -= signDouble * mx.at(i, j);
-                }
+                implicitRow(i, k, x);
             }
+            
+            if (outOfBudget())
+            {
+                break;
+            }
+            
+            ++flips;
+            flipped = true;
+            Z.flip(i);
+            lastNorm = gradFlip + eps;
+            
+            Algebra::Kernels::axpy(-signDouble, x.memptr(), direction.memptr(), Src.n_cols);
         }
     } while (flipped);
     
     return Z;
 }
 
-arma::vec &CentroidDecomposition::findOptimizedSSV(arma::mat &mx, uint64_t k)
+Algebra::SignVector &CentroidDecomposition::findOptimizedSSV(arma::mat &Xt, uint64_t k)
 {
     if (!decomposed)
     {
-        arma::vec &Z = signVectors[k]; // get a reference
-        
-        std::vector<double> direction = std::vector<double>(mx.n_cols);
-        
-        for (uint64_t j = 0; j < mx.n_cols; ++j)
-        {
-            direction[j] = mx.at(0, j);
-        }
-        
-        for (uint64_t i = 1; i < mx.n_rows; ++i)
+        std::vector<double> direction = std::vector<double>(Xt.n_rows);
+        greedySignVector(Xt, signVectors[k], direction.data());
+    }
+    
+    return strategy == CDSignVectorStrategy_2::ISSVInit ? findIncrementalSSV(Xt, k) : findIncrementalSSVPlus(Xt, k);
+}
+
+// V := V + factor * G_*flipped (skipping v_flipped itself), then the next row to flip is the first one with the largest
+// |v_i| > floor among z_i * v_i < 0, or minusone; both in one pass over V. Every flip changes all of V, so a priority
+// queue over the gains would be rebuilt every time, the pass is what it would cost anyway.
+uint64_t CentroidDecomposition::updateAndSelect(const Algebra::SignVector &Z, arma::vec &V,
+                                                const double *g, double factor, uint64_t flipped, double floor)
+{
+    uint64_t n = V.n_elem;
+    uint64_t chunks = threads > 1 ? threads : 1;
+    std::vector<uint64_t> best(chunks, minusone);
+    std::vector<double> bestVal(chunks, floor);
+    
+    #pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+    for (uint64_t c = 0; c < chunks; ++c)
+    {
+        for (uint64_t i = c * n / chunks; i < (c + 1) * n / chunks; ++i)
         {
-            double gradPlus = 0.0;
-            double gradMinus = 0.0;
-            
-            for (uint64_t j = 0; j < mx.n_cols; ++j)
+            if (g != nullptr && i != flipped)
             {
-                double localModPlus = direction[j] + mx.at(i, j);
-                gradPlus += localModPlus * localModPlus;
-                double localModMinus = direction[j] - mx.at(i, j);
-                gradMinus += localModMinus * localModMinus;
+                V[i] += factor * g[i];
             }
             
-            double sign = gradPlus > gradMinus ? 1 : -1;
-            Z[i] = sign;
-            
-            for (uint64_t j = 0; j < mx.n_cols; ++j)
+            if (Z[i] * V[i] < 0 && fabs(V[i]) > bestVal[c])
             {
-                direction[j] += sign * mx.at(i, j);
+                bestVal[c] = fabs(V[i]);
+                best[c] = i;
             }
         }
     }
     
-    return strategy == CDSignVectorStrategy_2::ISSVInit ? findIncrementalSSV(mx, k) : findIncrementalSSVPlus(mx, k);
+    // chunks go in row order and the comparison is strict - the first maximum wins for any amount of threads
+    uint64_t pos = minusone;
+    double val = floor;
+    
+    for (uint64_t c = 0; c < chunks; ++c)
+    {
+        if (best[c] != minusone && bestVal[c] > val)
+        {
+            val = bestVal[c];
+            pos = best[c];
+        }
+    }
+    
+    return pos;
 }
 
-arma::vec &CentroidDecomposition::findIncrementalSSVPlus(arma::mat &mx, uint64_t k)
+Algebra::SignVector &CentroidDecomposition::findIncrementalSSVPlus(arma::mat &Xt, uint64_t k)
 {
     // Scalable Sign Vector
-    uint64_t pos = minusone;
-    double val = 0.0;
+    uint64_t pos;
+    double val;
     
-    arma::vec &Z = signVectors[k]; // get a reference
+    Algebra::SignVector &Z = signVectors[k]; // get a reference
     
     arma::vec S(Src.n_cols);
-    arma::vec V(Src.n_rows);
-    
-    // pre-process rows of X
-    std::vector<arma::vec> x_ = std::vector<arma::vec>();
-    
-    for (uint64_t i = 0; i < mx.n_rows; ++i)
-    {
-        x_.emplace_back(mx.row(i).t());
-    }
+    arma::vec V(Xt.n_cols);
     
+    // <X_l*, X_pos*> for all l, rows of X are the columns of Xt
+    Algebra::GramCache gram(Xt, gramCacheBytes);
     
     // ITERATION #1
     
     // S = Sum(1:n) { z_i * (X_i* ^ T) }
-    
-    // i = 0
-    {
-        for (uint64_t j = 0; j < S.n_elem; ++j)
-        {
-            S[j] = x_[0][j] * Z[0];
-        }
-    }
-    
-    for (uint64_t i = 1; i < mx.n_rows; ++i)
-    {
-        for (uint64_t j = 0; j < S.n_elem; ++j)
-        {
-            S[j] += x_[i][j] * Z[i];
-        }
-    }
+    signedRowSum(Xt, Z, S);
     
     
     // v_i = z_i * (z_i * X_i* * S - X_i* * (X_i*)^T)
-    for (uint64_t i = 0; i < mx.n_rows; ++i)
+    #pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+    for (uint64_t i = 0; i < Xt.n_cols; ++i)
     {
+        const double *x = Xt.colptr(i);
         V[i] = Z[i] * (
-                Z[i] * arma::dot(x_[i], S) - arma::dot(x_[i], x_[i])
+                Z[i] * Algebra::Kernels::dot(x, S.memptr(), Xt.n_rows) - Algebra::Kernels::dot(x, x, Xt.n_rows)
         );
     }
     
     // Search next element
-    
-    for (uint64_t i = 0; i < mx.n_rows; ++i)
-    {
-        if (Z[i] * V[i] < 0)
-        {
-            if (fabs(V[i]) > val)
-            {
-                val = fabs(V[i]);
-                pos = i;
-            }
-        }
-    }
+    pos = updateAndSelect(Z, V, nullptr, 0.0, minusone, 0.0);
     
     // ITERATIONS 2+
     
     // main loop
     while (pos != minusone)
     {
+        if (outOfBudget())
+        {
+            break;
+        }
+        
+        ++sweeps;
+        
         // Search next element to flip
         val = eps;
         pos = minusone;
         
-        for (uint64_t i = 0; i < mx.n_rows; ++i)
+        for (uint64_t i = 0; i < Xt.n_cols; ++i)
         {
             if (Z[i] * V[i] < 0)
             {
                 if (fabs(V[i]) > val)
                 {
+                    if (outOfBudget())
+                    {
+                        break;
+                    }
+                    
+                    ++flips;
                     val = fabs(V[i]);
                     pos = i;
                     
                     // change sign
-                    Z[pos] = Z[pos] * (-1.0);
+                    Z.flip(pos);
                     
                     double factor = Z[pos] + Z[pos];
+                    const double *g = gram.column(pos);
+                    
+                    Algebra::Kernels::axpy(factor, Xt.colptr(pos), S.memptr(), Xt.n_rows);
                     
                     // Determine V_k+1 from V_k
                     
-                    for (uint64_t l = 0; l < mx.n_rows; ++l)
+                    #pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+                    for (uint64_t l = 0; l < Xt.n_cols; ++l)
                     {
-                        V[l] = V[l] + factor * (l == pos ? 0 : arma::dot(x_[l], x_[pos]));
+                        V[l] = V[l] + factor * (l == pos ? 0 : g[l]);
                     }
                 }
             }
@@ -441,105 +1187,69 @@ arma::vec &CentroidDecomposition::findIncrementalSSVPlus(arma::mat &mx, uint64_t
         ++ssvIterations;
     }
     
+    // S = X^T * Z is kept up to date with the flips
+    directions[k] = S;
+    
     return Z;
 }
 
-arma::vec &CentroidDecomposition::findIncrementalSSV(arma::mat &mx, uint64_t k)
+Algebra::SignVector &CentroidDecomposition::findIncrementalSSV(arma::mat &Xt, uint64_t k)
 {
     // Scalable Sign Vector
-    uint64_t pos = minusone;
-    double val = 0.0;
+    uint64_t pos;
     
-    arma::vec &Z = signVectors[k]; // get a reference
+    Algebra::SignVector &Z = signVectors[k]; // get a reference
     
     arma::vec S(Src.n_cols);
-    arma::vec V(Src.n_rows);
-    
-    // pre-process rows of X
-    std::vector<arma::vec> x_ = std::vector<arma::vec>();
+    arma::vec V(Xt.n_cols);
     
-    for (uint64_t i = 0; i < mx.n_rows; ++i)
-    {
-        x_.emplace_back(mx.row(i).t());
-    }
+    // <X_l*, X_pos*> for all l, rows of X are the columns of Xt
+    Algebra::GramCache gram(Xt, gramCacheBytes);
     
     // ITERATION #1
     
     // S = Sum(1:n) { z_i * (X_i* ^ T) }
-    
-    // i = 0
-    {
-        for (uint64_t j = 0; j < S.n_elem; ++j)
-        {
-            S[j] = x_[0][j] * Z[0];
-        }
-    }
-    
-    for (uint64_t i = 1; i < mx.n_rows; ++i)
-    {
-        for (uint64_t j = 0; j < S.n_elem; ++j)
-        {
-            S[j] += x_[i][j] * Z[i];
-        }
-    }
-    
-    
+    signedRowSum(Xt, Z, S);
     
     // v_i = z_i * (z_i * X_i* * S - X_i* * (X_i*)^T)
-    for (uint64_t i = 0; i < mx.n_rows; ++i)
+    #pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+    for (uint64_t i = 0; i < Xt.n_cols; ++i)
     {
+        const double *x = Xt.colptr(i);
         V[i] = Z[i] * (
-                Z[i] * arma::dot(x_[i], S) - arma::dot(x_[i], x_[i])
+                Z[i] * Algebra::Kernels::dot(x, S.memptr(), Xt.n_rows) - Algebra::Kernels::dot(x, x, Xt.n_rows)
         );
     }
     
     // Search next element
+    pos = updateAndSelect(Z, V, nullptr, 0.0, minusone, 0.0);
     
-    for (uint64_t i = 0; i < mx.n_rows; ++i)
-    {
-        if (Z[i] * V[i] < 0)
-        {
-            if (fabs(V[i]) > val)
-            {
-                val = fabs(V[i]);
-                pos = i;
-            }
-        }
-    }
-
     // ITERATIONS 2+
     
     // main loop
     while (pos != minusone)
     {
+        if (outOfBudget())
+        {
+            break;
+        }
+        
+        ++flips;
+        
         // change sign
-        Z[pos] = Z[pos] * (-1.0);
+        Z.flip(pos);
         
-        // Determine V_k+1 from V_k
+        Algebra::Kernels::axpy(2 * Z[pos], Xt.colptr(pos), S.memptr(), Xt.n_rows);
         
-        for (uint64_t i = 0; i < mx.n_rows; ++i)
-        {
-            V[i] += 2 * Z[pos] * (i == pos ? 0 : arma::dot(x_[i], x_[pos]));
-        }
-
-        // Search next element to flip
-        val = 0.0;
-        pos = minusone;
+        // Determine V_k+1 from V_k, search next element to flip
+        pos = updateAndSelect(Z, V, gram.column(pos), 2 * Z[pos], pos, 0.0);
         
-        for (uint64_t i = 0; i < mx.n_rows; ++i)
-        {
-            if (Z[i] * V[i] < 0)
-            {
-                if (fabs(V[i]) > val)
-                {
-                    val = fabs(V[i]);
-                    pos = i;
-                }
-            }
-        }
         ++ssvIterations;
     }
     
+    // S = X^T * Z is kept up to date with the flips
+    directions[k] = S;
+    
     return Z;
 }
 
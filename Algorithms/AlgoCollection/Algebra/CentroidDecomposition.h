@@ -2,8 +2,12 @@
 // Created by Zakhar on 08.03.2017.
 //
 
+#include <chrono>
 #include <armadillo>
 
+#include "SignVector.h"
+#include "../MathIO/Checkpoint.h"
+
 #pragma once
 
 namespace Algorithms
@@ -32,11 +36,21 @@ class CentroidDecomposition
     arma::mat Rel;
   
   public:
-    std::vector<arma::vec> signVectors;
+    std::vector<Algebra::SignVector> signVectors;
     std::vector<arma::vec> directions;
     //std::vector<std::vector<arma::vec *>> signVectorSteps;
     uint64_t ssvIterations = 0;
     uint64_t truncation = 0;
+    uint64_t threads = 1; // > 1 - SSV and deflation are split over rows with OpenMP
+    uint64_t gramCacheBytes = 64 << 20; // ISSV: memory for blocks of X * X^T kept across flips, 0 - computed per flip
+    bool implicitDeflation = false; // true - Src is not copied, X_i is represented through Src, L and R [LSV only]
+    
+    // budgets of the sign vector search for one decomposition, 0 - unbounded
+    uint64_t maxSweeps = 0;
+    uint64_t maxFlips = 0;
+    uint64_t timeBudget = 0; // microseconds
+    bool searchTruncated = false; // a budget ran out during the last decomposition
+    uint64_t truncatedSearches = 0; // amount of such decompositions
     
     CDSignVectorStrategy_2 strategy;
     
@@ -68,8 +82,11 @@ class CentroidDecomposition
     
     void resetSignVectors();
     
+    // rows [rows, n) of Src (rows = 0 - none) are left out: rows of a stream that haven't arrived yet, the newest ones;
+    // their loads are zero and neither the sign vectors nor the cached directions account for them until they are
+    // committed, the implicit deflation isn't used then
     void performDecomposition(std::vector<double> *centroidValues = nullptr,
-                              bool stopOnIncompleteRank = false, bool skipSSV = false);
+                              bool stopOnIncompleteRank = false, bool skipSSV = false, uint64_t rows = 0);
     
     void increment(const arma::vec &vec);
     
@@ -77,6 +94,46 @@ class CentroidDecomposition
     
     void increment_raw(uint64_t newrows);
     
+    void projectRow(uint64_t i);
+    
+    void commitRow(uint64_t i);
+    
+    void retractRow(uint64_t i);
+    
+    // L_i* := least squares fit of the entries of Src_i* that aren't in <missing> (ascending) on the same rows of Rel;
+    // residual - ||x_obs - R_obs * L_i*^T|| / ||x_obs||; false - less observed entries than components or a singular
+    // system, Load is left as it is
+    bool foldInRow(uint64_t i, const std::vector<uint64_t> &missing, double &residual);
+    
+    void setWindow(uint64_t capacity);
+    
+    uint64_t getWindow() const;
+    
+    uint64_t getWindowHead() const;
+    
+    // flips made by the sign vector search during the last decomposition
+    uint64_t getFlips() const;
+    
+    // centroid values of Src with the current sign vectors, without a search, up to the first one below eps;
+    // O(n * m * k)
+    void centroidSpectrum(std::vector<double> &centroidValues);
+    
+    uint64_t slideWindow();
+    
+    // the oldest row of the window is moved to row 0 and the others follow in arrival order; returns the amount of rows
+    // the old slots are moved up by (row r is at (r - shift) mod n now), 0 - the order was right already
+    uint64_t unrollWindow();
+    
+    // the decomposition, sign vectors, directions, truncation, strategy and the row/window bookkeeping;
+    // Src itself is not a part of it
+    void saveState(MathIO::CheckpointWriter &writer) const;
+    
+    // Src has to hold the same rows it had when the state was saved
+    void loadState(MathIO::CheckpointReader &reader);
+    
+    // the state saveState() covers is exchanged with the one of other, Src and the settings stay
+    void swapState(CentroidDecomposition &other);
+    
     //
     // Algorithm
     //
@@ -84,15 +141,46 @@ class CentroidDecomposition
     bool decomposed = false;
     uint64_t addedRows = 0;
     
-    arma::vec &findSignVector(arma::mat &mx, uint64_t k);
+    uint64_t window = 0; // 0 - unbounded
+    uint64_t windowHead = 0;
+    
+    arma::vec srcRowNorms; // implicit deflation only
+    
+    arma::mat relGram; // Rel^T * Rel for fold-in, empty - not computed for the current Rel
+    
+    uint64_t sweeps = 0;
+    uint64_t flips = 0;
+    std::chrono::steady_clock::time_point deadline;
+    
+    bool outOfBudget();
+    
+    void greedySignVector(const arma::mat &Xt, Algebra::SignVector &Z, double *direction);
+    
+    void signedRowSum(const arma::mat &Xt, const Algebra::SignVector &Z, arma::vec &direction);
+    
+    void deflate(arma::mat &Xt, const arma::vec &Rel_i, arma::vec &Load_i);
     
-    arma::vec &findLocalSignVector(arma::mat &mx, uint64_t k, bool useInit);
+    void implicitRow(uint64_t i, uint64_t k, arma::vec &x);
     
-    arma::vec &findOptimizedSSV(arma::mat &mx, uint64_t k);
+    void implicitProduct(uint64_t k, const arma::vec &v, arma::vec &res);
     
-    arma::vec &findIncrementalSSV(arma::mat &mx, uint64_t k);
+    void implicitSignedRowSum(uint64_t k, const Algebra::SignVector &Z, arma::vec &direction);
     
-    arma::vec &findIncrementalSSVPlus(arma::mat &mx, uint64_t k);
+    // Xt is the transposed (m x n) working copy, a row of the deflated matrix is a contiguous column of Xt
+    Algebra::SignVector &findSignVector(arma::mat &Xt, uint64_t k);
+    
+    Algebra::SignVector &findLocalSignVector(arma::mat &Xt, uint64_t k, bool useInit);
+    
+    Algebra::SignVector &findImplicitSignVector(uint64_t k, bool useInit);
+    
+    Algebra::SignVector &findOptimizedSSV(arma::mat &Xt, uint64_t k);
+    
+    Algebra::SignVector &findIncrementalSSV(arma::mat &Xt, uint64_t k);
+    
+    uint64_t updateAndSelect(const Algebra::SignVector &Z, arma::vec &V,
+                             const double *g, double factor, uint64_t flipped, double floor);
+    
+    Algebra::SignVector &findIncrementalSSVPlus(arma::mat &Xt, uint64_t k);
   
     //
     // Static
@@ -102,6 +190,8 @@ class CentroidDecomposition
     
     static constexpr uint64_t minusone = static_cast<uint64_t>(-1);
     
+    static constexpr uint64_t parallelBlock = 256; // rows per partial sum, fixed so the result doesn't depend on threads
+    
     static constexpr CDSignVectorStrategy_2 defaultSignVectorStrategy = CDSignVectorStrategy_2::LSVBase;
     
     static std::pair<arma::mat, arma::mat> PerformCentroidDecomposition(arma::mat &mx, uint64_t k = 0);
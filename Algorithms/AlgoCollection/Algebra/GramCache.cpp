@@ -0,0 +1,44 @@
+#include "GramCache.h"
+
+namespace Algebra
+{
+
+//
+// GramCache constructors & desctructors
+//
+
+GramCache::GramCache(const arma::mat &Xt, uint64_t budget)
+        : Xt(Xt),
+          budget(budget),
+          blocks((Xt.n_cols + blockSize - 1) / blockSize)
+{ }
+
+//
+// GramCache API
+//
+
+const double *GramCache::column(uint64_t pos)
+{
+    uint64_t b = pos / blockSize;
+    uint64_t first = b * blockSize;
+    
+    if (blocks[b].n_elem == 0)
+    {
+        uint64_t last = std::min<uint64_t>(first + blockSize, Xt.n_cols) - 1;
+        uint64_t size = Xt.n_cols * (last - first + 1) * sizeof(double);
+        
+        if (used + size > budget)
+        {
+            // no room, single column
+            scratch = Xt.t() * Xt.col(pos);
+            return scratch.memptr();
+        }
+        
+        blocks[b] = Xt.t() * Xt.cols(first, last);
+        used += size;
+    }
+    
+    return blocks[b].colptr(pos - first);
+}
+
+} // namespace Algebra
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <armadillo>
+
+namespace Algebra
+{
+
+// Columns of the Gram matrix G = X * X^T, for a matrix given as its transpose Xt (rows of X are columns of Xt).
+// G is filled lazily by blocks of columns, each block is one matrix-matrix product, as long as the blocks fit into
+// the memory budget; past that, columns are computed on demand and not kept.
+class GramCache
+{
+    //
+    // Data
+    //
+  private:
+    const arma::mat &Xt;
+    uint64_t budget; // bytes
+    uint64_t used = 0;
+    std::vector<arma::mat> blocks;
+    arma::vec scratch;
+    
+    //
+    // Constructors & destructors
+    //
+  public:
+    GramCache(const arma::mat &Xt, uint64_t budget);
+    
+    //
+    // API
+    //
+  public:
+    // G_*pos = X * X_pos*^T, n elements; stays valid until the next call
+    const double *column(uint64_t pos);
+    
+    //
+    // Static
+    //
+  public:
+    static constexpr uint64_t blockSize = 256;
+};
+
+} // namespace Algebra
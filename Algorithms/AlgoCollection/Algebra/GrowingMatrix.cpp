@@ -0,0 +1,106 @@
+#include <cassert>
+#include "GrowingMatrix.h"
+
+namespace Algebra
+{
+
+//
+// GrowingMatrix constructors & desctructors
+//
+
+GrowingMatrix::GrowingMatrix(uint64_t m, uint64_t capacity)
+        : storage(capacity > minCapacity ? capacity : minCapacity, m),
+          rows(0)
+{ }
+
+//
+// GrowingMatrix API
+//
+
+uint64_t GrowingMatrix::n_rows() const
+{
+    return rows;
+}
+
+uint64_t GrowingMatrix::n_cols() const
+{
+    return storage.n_cols;
+}
+
+uint64_t GrowingMatrix::capacity() const
+{
+    return storage.n_rows;
+}
+
+void GrowingMatrix::reserve(uint64_t capacity)
+{
+    if (capacity > storage.n_rows)
+    {
+        // one copy of the active part per reallocation, resize() keeps the content
+        storage.resize(capacity, storage.n_cols);
+    }
+}
+
+void GrowingMatrix::appendRow(const std::vector<double> &vector)
+{
+    assert(vector.size() == storage.n_cols);
+    
+    appendRows(1, 0.0);
+    
+    for (uint64_t j = 0; j < storage.n_cols; ++j)
+    {
+        storage.at(rows - 1, j) = vector[j];
+    }
+}
+
+void GrowingMatrix::appendRow(const arma::vec &vector)
+{
+    assert(vector.n_elem == storage.n_cols);
+    
+    appendRows(1, 0.0);
+    
+    for (uint64_t j = 0; j < storage.n_cols; ++j)
+    {
+        storage.at(rows - 1, j) = vector[j];
+    }
+}
+
+void GrowingMatrix::appendRows(uint64_t count, double val)
+{
+    if (rows + count > storage.n_rows)
+    {
+        reserve(std::max<uint64_t>(storage.n_rows * 2, rows + count));
+    }
+    
+    for (uint64_t j = 0; j < storage.n_cols; ++j)
+    {
+        for (uint64_t i = rows; i < rows + count; ++i)
+        {
+            storage.at(i, j) = val;
+        }
+    }
+    
+    rows += count;
+}
+
+double &GrowingMatrix::at(uint64_t i, uint64_t j)
+{
+    return storage.at(i, j);
+}
+
+double *GrowingMatrix::colptr(uint64_t j)
+{
+    return storage.colptr(j);
+}
+
+arma::mat GrowingMatrix::toMatrix() const
+{
+    if (rows == 0)
+    {
+        return arma::mat(0, storage.n_cols);
+    }
+    
+    return storage.rows(0, rows - 1);
+}
+
+} // namespace Algebra
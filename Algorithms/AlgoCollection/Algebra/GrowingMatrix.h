@@ -0,0 +1,56 @@
+#pragma once
+
+#include <armadillo>
+
+namespace Algebra
+{
+
+// Column-major matrix which grows by rows with geometric capacity, so appending N rows costs amortized O(N * m).
+// Rows [0, n_rows()) are the active part, the rest of the storage is reserved for future appends.
+class GrowingMatrix
+{
+    //
+    // Data
+    //
+  private:
+    arma::mat storage;
+    uint64_t rows;
+    
+    //
+    // Constructors & destructors
+    //
+  public:
+    explicit GrowingMatrix(uint64_t m, uint64_t capacity = minCapacity);
+    
+    //
+    // API
+    //
+  public:
+    uint64_t n_rows() const;
+    
+    uint64_t n_cols() const;
+    
+    uint64_t capacity() const;
+    
+    void reserve(uint64_t capacity);
+    
+    void appendRow(const std::vector<double> &vector);
+    
+    void appendRow(const arma::vec &vector);
+    
+    void appendRows(uint64_t count, double val);
+    
+    double &at(uint64_t i, uint64_t j);
+    
+    double *colptr(uint64_t j);
+    
+    arma::mat toMatrix() const;
+    
+    //
+    // Static
+    //
+  public:
+    static constexpr uint64_t minCapacity = 16;
+};
+
+} // namespace Algebra
@@ -0,0 +1,190 @@
+#include "Kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace Algebra
+{
+
+namespace Kernels
+{
+
+//
+// Scalar
+//
+
+static double dot_scalar(const double *x, const double *y, uint64_t n)
+{
+    double res = 0.0;
+    
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        res += x[i] * y[i];
+    }
+    
+    return res;
+}
+
+static void axpy_scalar(double alpha, const double *x, double *y, uint64_t n)
+{
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        y[i] += alpha * x[i];
+    }
+}
+
+#ifdef KERNELS_X86
+
+//
+// SSE4.2 (the build passes -msse4.2, the dispatch still checks for it)
+//
+
+__attribute__((target("sse4.2")))
+static double dot_sse(const double *x, const double *y, uint64_t n)
+{
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    uint64_t i = 0;
+    
+    for (; i + 4 <= n; i += 4)
+    {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+    }
+    
+    acc0 = _mm_add_pd(acc0, acc1);
+    double res = _mm_cvtsd_f64(_mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0)));
+    
+    for (; i < n; ++i)
+    {
+        res += x[i] * y[i];
+    }
+    
+    return res;
+}
+
+__attribute__((target("sse4.2")))
+static void axpy_sse(double alpha, const double *x, double *y, uint64_t n)
+{
+    __m128d a = _mm_set1_pd(alpha);
+    uint64_t i = 0;
+    
+    for (; i + 2 <= n; i += 2)
+    {
+        _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(a, _mm_loadu_pd(x + i))));
+    }
+    
+    for (; i < n; ++i)
+    {
+        y[i] += alpha * x[i];
+    }
+}
+
+//
+// AVX2 + FMA
+//
+
+__attribute__((target("avx2,fma")))
+static double dot_avx2(const double *x, const double *y, uint64_t n)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    uint64_t i = 0;
+    
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4), acc1);
+    }
+    
+    for (; i + 4 <= n; i += 4)
+    {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), acc0);
+    }
+    
+    acc0 = _mm256_add_pd(acc0, acc1);
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+    double res = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    
+    for (; i < n; ++i)
+    {
+        res += x[i] * y[i];
+    }
+    
+    return res;
+}
+
+__attribute__((target("avx2,fma")))
+static void axpy_avx2(double alpha, const double *x, double *y, uint64_t n)
+{
+    __m256d a = _mm256_set1_pd(alpha);
+    uint64_t i = 0;
+    
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm256_storeu_pd(y + i, _mm256_fmadd_pd(a, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+    }
+    
+    for (; i < n; ++i)
+    {
+        y[i] += alpha * x[i];
+    }
+}
+
+#endif
+
+//
+// Dispatch
+//
+
+struct KernelTable
+{
+    double (*dot)(const double *, const double *, uint64_t);
+    void (*axpy)(double, const double *, double *, uint64_t);
+    const char *isa;
+};
+
+static KernelTable select()
+{
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return KernelTable { dot_avx2, axpy_avx2, "avx2" };
+    }
+    
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return KernelTable { dot_sse, axpy_sse, "sse4.2" };
+    }
+#endif
+    
+    return KernelTable { dot_scalar, axpy_scalar, "scalar" };
+}
+
+static const KernelTable &table()
+{
+    static const KernelTable kernels = select();
+    return kernels;
+}
+
+double dot(const double *x, const double *y, uint64_t n)
+{
+    return table().dot(x, y, n);
+}
+
+void axpy(double alpha, const double *x, double *y, uint64_t n)
+{
+    table().axpy(alpha, x, y, n);
+}
+
+const char *isa()
+{
+    return table().isa;
+}
+
+} // namespace Kernels
+} // namespace Algebra
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Algebra
+{
+
+// Dense kernels for the hot loops of the sign vector search, dispatched at runtime to AVX2 (+FMA), SSE4.2 or plain
+// scalar code, depending on what the CPU supports. Dispatch is resolved once, on the first call.
+namespace Kernels
+{
+
+// <x, y>
+double dot(const double *x, const double *y, uint64_t n);
+
+// y := y + alpha * x
+void axpy(double alpha, const double *x, double *y, uint64_t n);
+
+// name of the instruction set the kernels were dispatched to
+const char *isa();
+
+} // namespace Kernels
+} // namespace Algebra
@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "MissingIndex.h"
+
+namespace Algebra
+{
+
+constexpr uint64_t MissingIndex::none;
+
+//
+// MissingIndex API
+//
+
+void MissingIndex::add(uint64_t col, uint64_t start, uint64_t size)
+{
+    columns.push_back(col);
+    starts.push_back(start);
+    sizes.push_back(size);
+    total += size;
+    
+    if (col >= tails.size())
+    {
+        tails.resize(col + 1, none);
+    }
+    
+    tails[col] = columns.size() - 1;
+}
+
+void MissingIndex::scan(const arma::mat &matrix, double val /*= NAN*/)
+{
+    bool nan = std::isnan(val);
+    
+    if (matrix.n_rows < scanned)
+    {
+        // rows were dropped, the runs can't be trusted anymore
+        clear();
+        scanned = 0;
+        changed.clear();
+        queued.clear();
+    }
+    
+    if (tails.size() < matrix.n_cols)
+    {
+        tails.resize(matrix.n_cols, none);
+    }
+    
+    std::sort(changed.begin(), changed.end());
+    
+    for (uint64_t i : changed)
+    {
+        queued[i] = false;
+        
+        for (uint64_t j = 0; j < matrix.n_cols; ++j)
+        {
+            double cell = matrix.at(i, j);
+            
+            if (nan ? std::isnan(cell) : cell == val)
+            {
+                addCell(j, i);
+            }
+        }
+    }
+    changed.clear();
+    
+    for (uint64_t j = 0; j < matrix.n_cols; ++j)
+    {
+        const double *col = matrix.colptr(j);
+        uint64_t run = tails[j];
+        bool open = run != none && starts[run] + sizes[run] == scanned;
+        
+        for (uint64_t i = scanned; i < matrix.n_rows; ++i)
+        {
+            if (nan ? std::isnan(col[i]) : col[i] == val)
+            {
+                if (open)
+                {
+                    ++sizes[run];
+                    ++total;
+                }
+                else
+                {
+                    add(j, i, 1);
+                    run = columns.size() - 1;
+                    open = true;
+                }
+            }
+            else
+            {
+                open = false;
+            }
+        }
+    }
+    
+    scanned = std::max<uint64_t>(scanned, matrix.n_rows);
+}
+
+void MissingIndex::rescan(uint64_t first, uint64_t count /*= 1*/)
+{
+    uint64_t last = std::min<uint64_t>(first + count, scanned); // rows past the frontier are scanned anyway
+    
+    if (first >= last)
+    {
+        return;
+    }
+    
+    if (queued.size() < scanned)
+    {
+        queued.resize(scanned, false);
+    }
+    
+    // a row is queued once however often it's overwritten, the queue never outgrows the scanned rows
+    for (uint64_t i = first; i < last; ++i)
+    {
+        if (!queued[i])
+        {
+            queued[i] = true;
+            changed.push_back(i);
+        }
+    }
+    
+    bool overlaps = false;
+    
+    for (uint64_t r = 0; r < columns.size() && !overlaps; ++r)
+    {
+        overlaps = starts[r] < last && starts[r] + sizes[r] > first;
+    }
+    
+    if (!overlaps)
+    {
+        return; // the runs stay as they are, e.g. a pushed row that takes a complete one's slot
+    }
+    
+    std::vector<uint64_t> oldColumns = std::move(columns);
+    std::vector<uint64_t> oldStarts = std::move(starts);
+    std::vector<uint64_t> oldSizes = std::move(sizes);
+    
+    clear();
+    
+    // what is left of every run around [first, last), in the same order
+    for (uint64_t r = 0; r < oldColumns.size(); ++r)
+    {
+        uint64_t start = oldStarts[r];
+        uint64_t end = start + oldSizes[r];
+        
+        if (start < first)
+        {
+            add(oldColumns[r], start, std::min(end, first) - start);
+        }
+        if (end > last)
+        {
+            uint64_t from = std::max(start, last);
+            add(oldColumns[r], from, end - from);
+        }
+    }
+    
+    resetTails();
+}
+
+void MissingIndex::rotate(uint64_t shift, uint64_t n)
+{
+    if (shift == 0)
+    {
+        return;
+    }
+    
+    std::vector<uint64_t> oldColumns = std::move(columns);
+    std::vector<uint64_t> oldStarts = std::move(starts);
+    std::vector<uint64_t> oldSizes = std::move(sizes);
+    
+    clear();
+    
+    for (uint64_t r = 0; r < oldColumns.size(); ++r)
+    {
+        uint64_t start = (oldStarts[r] + n - shift) % n;
+        
+        // a run over the seam of the ring is split in two, its rows aren't adjacent anymore
+        if (start + oldSizes[r] > n)
+        {
+            add(oldColumns[r], start, n - start);
+            add(oldColumns[r], 0, start + oldSizes[r] - n);
+        }
+        else
+        {
+            add(oldColumns[r], start, oldSizes[r]);
+        }
+    }
+    
+    resetTails();
+    
+    for (uint64_t &i : changed)
+    {
+        i = (i + n - shift) % n;
+    }
+    
+    resetQueued();
+}
+
+void MissingIndex::addCell(uint64_t col, uint64_t row)
+{
+    // a run of the column that ends right above it grows, otherwise the cell is a run of its own; the run that can
+    // still grow is the one that reaches the frontier
+    uint64_t tail = tails[col];
+    uint64_t run = none;
+    
+    for (uint64_t r = 0; r < columns.size() && run == none; ++r)
+    {
+        if (columns[r] == col && starts[r] + sizes[r] == row)
+        {
+            run = r;
+            ++sizes[r];
+            ++total;
+        }
+    }
+    
+    if (run == none)
+    {
+        add(col, row, 1);
+        run = columns.size() - 1;
+    }
+    
+    tails[col] = starts[run] + sizes[run] == scanned ? run : tail;
+}
+
+void MissingIndex::resetTails()
+{
+    // only a run that reaches the frontier can grow
+    std::fill(tails.begin(), tails.end(), none);
+    
+    for (uint64_t r = 0; r < columns.size(); ++r)
+    {
+        if (starts[r] + sizes[r] == scanned)
+        {
+            tails[columns[r]] = r;
+        }
+    }
+}
+
+void MissingIndex::resetQueued()
+{
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    
+    queued.assign(scanned, false);
+    
+    for (uint64_t i : changed)
+    {
+        queued[i] = true;
+    }
+}
+
+void MissingIndex::clear()
+{
+    columns.clear();
+    starts.clear();
+    sizes.clear();
+    std::fill(tails.begin(), tails.end(), none);
+    total = 0;
+}
+
+std::vector<uint64_t> MissingIndex::offsets() const
+{
+    std::vector<uint64_t> res(runs());
+    
+    for (uint64_t r = 1; r < runs(); ++r)
+    {
+        res[r] = res[r - 1] + sizes[r - 1];
+    }
+    
+    return res;
+}
+
+void MissingIndex::saveState(MathIO::CheckpointWriter &writer) const
+{
+    writer.write(columns);
+    writer.write(starts);
+    writer.write(sizes);
+    writer.write(tails);
+    writer.write(total);
+    writer.write(scanned);
+    writer.write(changed);
+}
+
+void MissingIndex::loadState(MathIO::CheckpointReader &reader)
+{
+    reader.read(columns);
+    reader.read(starts);
+    reader.read(sizes);
+    reader.read(tails);
+    total = reader.readWord();
+    scanned = reader.readWord();
+    reader.read(changed);
+    
+    if (std::any_of(changed.begin(), changed.end(), [this](uint64_t i) { return i >= scanned; }))
+    {
+        throw std::runtime_error("checkpoint has a row to rescan past the scanned ones");
+    }
+    
+    resetQueued(); // checkpoints of older builds may list a row more than once
+}
+
+} // namespace Algebra
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <armadillo>
+
+#include "../MathIO/Checkpoint.h"
+
+namespace Algebra
+{
+
+// Missing cells of a matrix as runs of consecutive rows in one column, kept in flat arrays. Runs are in the order they
+// were found; vectors over the missing cells lay them out one run after another.
+// Rows are scanned once: a scan only looks at the rows appended since the previous one, and a run that reached the
+// last scanned row is extended instead of starting a new one.
+class MissingIndex
+{
+    //
+    // Data
+    //
+  private:
+    std::vector<uint64_t> columns;
+    std::vector<uint64_t> starts;
+    std::vector<uint64_t> sizes;
+    std::vector<uint64_t> tails; // per column, the run which can still grow, or none
+    uint64_t total = 0;
+    uint64_t scanned = 0;
+    std::vector<uint64_t> changed; // scanned rows to be looked at again by the next scan
+    std::vector<bool> queued; // per row, it's in changed
+    
+    //
+    // API
+    //
+  public:
+    uint64_t runs() const
+    {
+        return columns.size();
+    }
+    
+    uint64_t cells() const
+    {
+        return total;
+    }
+    
+    uint64_t column(uint64_t r) const
+    {
+        return columns[r];
+    }
+    
+    uint64_t start(uint64_t r) const
+    {
+        return starts[r];
+    }
+    
+    uint64_t size(uint64_t r) const
+    {
+        return sizes[r];
+    }
+    
+    uint64_t scannedRows() const
+    {
+        return scanned;
+    }
+    
+    // rows the next scan looks at again, each of them once
+    uint64_t changedRows() const
+    {
+        return changed.size();
+    }
+    
+    void add(uint64_t col, uint64_t start, uint64_t size);
+    
+    // rows [scannedRows(), n_rows) of matrix and the rows passed to rescan, cells equal to val are missing (NaN - any
+    // NaN); if the matrix has less rows than that, the index starts over from row 0
+    void scan(const arma::mat &matrix, double val = NAN);
+    
+    // rows [first, first + count) were overwritten since they were scanned: their cells leave the runs, the next scan
+    // looks at them again
+    void rescan(uint64_t first, uint64_t count = 1);
+    
+    // forgets the runs, the rows stay scanned
+    void clear();
+    
+    // rows of a ring of n rows moved up by shift (row r is at (r - shift) mod n now), runs follow them
+    void rotate(uint64_t shift, uint64_t n);
+    
+    // position of the first cell of every run in the layout
+    std::vector<uint64_t> offsets() const;
+    
+    void saveState(MathIO::CheckpointWriter &writer) const;
+    
+    void loadState(MathIO::CheckpointReader &reader);
+    
+    //
+    // Algorithm
+    //
+  private:
+    void addCell(uint64_t col, uint64_t row);
+    
+    void resetTails();
+    
+    void resetQueued();
+    
+    //
+    // Static
+    //
+  public:
+    static constexpr uint64_t none = static_cast<uint64_t>(-1);
+};
+
+} // namespace Algebra
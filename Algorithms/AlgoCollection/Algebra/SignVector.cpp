@@ -0,0 +1,67 @@
+#include "SignVector.h"
+
+namespace Algebra
+{
+
+//
+// SignVector constructors & desctructors
+//
+
+SignVector::SignVector(uint64_t n)
+        : words((n + 63) / 64, 0),
+          n(n)
+{ }
+
+//
+// SignVector API
+//
+
+void SignVector::append(uint64_t count)
+{
+    n += count;
+    words.resize((n + 63) / 64, 0); // vector's growth is geometric
+}
+
+void SignVector::reset()
+{
+    std::fill(words.begin(), words.end(), 0);
+}
+
+double SignVector::dot(const double *v) const
+{
+    double plain = 0.0;
+    double negative = 0.0;
+    
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        plain += v[i];
+    }
+    
+    for (uint64_t w = 0; w < words.size(); ++w)
+    {
+        uint64_t bits = words[w];
+        
+        while (bits != 0)
+        {
+            uint64_t i = w * 64 + static_cast<uint64_t>(__builtin_ctzll(bits));
+            negative += v[i];
+            bits &= bits - 1;
+        }
+    }
+    
+    return plain - 2.0 * negative;
+}
+
+arma::vec SignVector::toVector() const
+{
+    arma::vec z(n);
+    
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        z[i] = (*this)[i];
+    }
+    
+    return z;
+}
+
+} // namespace Algebra
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <armadillo>
+
+namespace Algebra
+{
+
+// Vector of {+1, -1}^n packed as a bitset, bit i set <=> z_i = -1. Bits past the end are always clear.
+class SignVector
+{
+    //
+    // Data
+    //
+  private:
+    std::vector<uint64_t> words;
+    uint64_t n;
+    
+    //
+    // Constructors & destructors
+    //
+  public:
+    explicit SignVector(uint64_t n = 0);
+    
+    //
+    // API
+    //
+  public:
+    uint64_t size() const
+    {
+        return n;
+    }
+    
+    double operator[](uint64_t i) const
+    {
+        return (words[i >> 6] >> (i & 63)) & 1 ? -1.0 : 1.0;
+    }
+    
+    void set(uint64_t i, double sign)
+    {
+        if (sign < 0.0)
+        {
+            words[i >> 6] |= (1ULL << (i & 63));
+        }
+        else
+        {
+            words[i >> 6] &= ~(1ULL << (i & 63));
+        }
+    }
+    
+    void flip(uint64_t i)
+    {
+        words[i >> 6] ^= (1ULL << (i & 63));
+    }
+    
+    // packed words, (size() + 63) / 64 of them
+    uint64_t *data()
+    {
+        return words.data();
+    }
+    
+    const uint64_t *data() const
+    {
+        return words.data();
+    }
+    
+    // new entries are +1
+    void append(uint64_t count);
+    
+    // all entries are +1
+    void reset();
+    
+    // <z, v>, only the entries with z_i = -1 are visited on top of the plain sum
+    double dot(const double *v) const;
+    
+    arma::vec toVector() const;
+};
+
+} // namespace Algebra
@@ -4,6 +4,7 @@
 
 #include "CDMissingValueRecovery.h"
 #include "../Stats/Correlation.h"
+#include "../Algebra/Kernels.h"
 
 #include <iostream>
 
@@ -19,8 +20,8 @@ CDMissingValueRecovery::CDMissingValueRecovery(arma::mat &src,
           cm(src),
           maxIterations(maxIterations), //defaults are hardcoded in CDMVR.h
           epsPrecision(eps),
-          missingBlocks(std::vector<MissingBlock>()),
-          disableCaching(false)
+          disableCaching(false),
+          moments(src.n_cols)
 { }
 
 uint64_t CDMissingValueRecovery::getReduction()
@@ -39,49 +40,53 @@ void CDMissingValueRecovery::passSignVectorStrategy(CDSignVectorStrategy_2 strat
     cd.strategy = strategy;
 }
 
+void CDMissingValueRecovery::passGramCache(uint64_t bytes)
+{
+    cd.gramCacheBytes = bytes;
+}
+
+// applies to every decomposition of the recovery, see CentroidDecomposition::outOfBudget()
+void CDMissingValueRecovery::setSearchBudget(uint64_t maxSweeps, uint64_t maxFlips, uint64_t timeBudget)
+{
+    cd.maxSweeps = maxSweeps;
+    cd.maxFlips = maxFlips;
+    cd.timeBudget = timeBudget;
+}
+
+uint64_t CDMissingValueRecovery::getTruncatedSearches()
+{
+    return cd.truncatedSearches;
+}
+
+void CDMissingValueRecovery::setThreads(uint64_t threads)
+{
+    cd.threads = threads == 0 ? 1 : threads;
+}
+
+void CDMissingValueRecovery::setImplicitDeflation(bool implicit)
+{
+    cd.implicitDeflation = implicit;
+}
+
 void CDMissingValueRecovery::addMissingBlock(uint64_t col, uint64_t start, uint64_t size)
 {
-    missingBlocks.emplace_back(MissingBlock(col, start, size, matrix));
+    missingIndex.add(col, start, size);
 }
 
 void CDMissingValueRecovery::addMissingBlock(MissingBlock mb)
 {
-    missingBlocks.emplace_back(mb);
+    missingIndex.add(mb.column, mb.startingIndex, mb.blockSize);
 }
 
 void CDMissingValueRecovery::autoDetectMissingBlocks(double val)
 {
-    for (uint64_t j = 0; j < matrix.n_cols; ++j)
-    {
-        bool missingBlock = false;
-        uint64_t start = 0;
-        
-        for (uint64_t i = 0; i < matrix.n_rows; ++i)
-        {
-            if ((std::isnan(val) && std::isnan(matrix.at(i, j))) || (!std::isnan(val) && matrix.at(i, j) == val))
-            {
-                if (!missingBlock)
-                {
-                    missingBlock = true;
-                    start = i;
-                }
-            }
-            else
-            {
-                if (missingBlock)
-                {
-                    //finalize block
-                    missingBlock = false;
-                    addMissingBlock(j, start, i - start);
-                }
-            }
-        }
-        
-        if (missingBlock)
-        {
-            addMissingBlock(j, start, matrix.n_rows - start);
-        }
-    }
+    unrollWindow();
+    missingIndex.scan(matrix, val);
+}
+
+void CDMissingValueRecovery::rescanRows(uint64_t first, uint64_t count /*= 1*/)
+{
+    missingIndex.rescan(first, count);
 }
 
 //
@@ -93,45 +98,148 @@ void CDMissingValueRecovery::decomposeOnly()
 }
 
 void CDMissingValueRecovery::increment(const std::vector<double> &vec)
+{
+    increment(arma::vec(vec));
+}
+
+void CDMissingValueRecovery::increment(const arma::vec &vec)
 {
     cd.increment(vec);
     
-    if (useNormalization && false) // not implemented
+    if (persistentNormalization)
     {
-        uint64_t lastIdx = matrix.n_rows - 1;
-        const std::vector<double> &mean = cm.getMean();
-        const std::vector<double> &stddev = cm.getStddev();
-        
-        for (uint64_t j = 0; j < matrix.n_cols; ++j)
-        {
-            matrix.at(lastIdx, j) = (matrix.at(lastIdx, j) - mean[j]) / stddev[j];
-        }
+        countArrivals();
     }
 }
 
-void CDMissingValueRecovery::increment(const arma::vec &vec)
+void CDMissingValueRecovery::increment_raw(uint64_t newrows)
 {
-    cd.increment(vec);
+    cd.increment_raw(newrows);
+    // the new rows are filled in by the caller, they are counted when they are recovered
+}
+
+void CDMissingValueRecovery::lockNormalization(bool locked /*= true*/)
+{
+    moments.locked = locked;
+}
+
+const Stats::RunningMoments &CDMissingValueRecovery::getMoments() const
+{
+    return moments;
+}
+
+const Algebra::MissingIndex &CDMissingValueRecovery::getMissingIndex() const
+{
+    return missingIndex;
+}
+
+void CDMissingValueRecovery::exportRecovered(arma::mat &out)
+{
+    const double *value = recoveredValues.data();
     
-    if (useNormalization && false) // not implemented
+    for (uint64_t b = 0; b < recovered.runs(); ++b)
     {
-        uint64_t lastIdx = matrix.n_rows - 1;
-        const std::vector<double> &mean = cm.getMean();
-        const std::vector<double> &stddev = cm.getStddev();
+        uint64_t col = recovered.column(b);
         
-        for (uint64_t j = 0; j < matrix.n_cols; ++j)
+        for (uint64_t i = recovered.start(b); i < recovered.start(b) + recovered.size(b); ++i)
         {
-            matrix.at(lastIdx, j) = (matrix.at(lastIdx, j) - mean[j]) / stddev[j];
+            out.at(i, col) = *value++;
         }
     }
+    
+    recovered.clear();
+    recoveredValues.clear();
 }
 
-void CDMissingValueRecovery::increment_raw(uint64_t newrows)
+bool CDMissingValueRecovery::saveCheckpoint(const std::string &path) const
 {
-    cd.increment_raw(newrows);
+    MathIO::CheckpointWriter writer(path);
+    
+    writer.write(matrix);
+    writer.write(k);
+    writer.write(streamFrontier);
+    writer.write(rowsSinceRefresh);
+    writer.write((uint64_t)persistentNormalization);
+    cd.saveState(writer);
+    missingIndex.saveState(writer);
     
-    if (useNormalization && false) // not implemented
-    { }
+    moments.saveState(writer);
+    writer.write(countedRows);
+    recovered.saveState(writer);
+    writer.write(recoveredValues);
+    
+    writer.write(spectrum);
+    writer.write(detectedReduction);
+    
+    writer.write((uint64_t)pending.size());
+    for (const PendingRow &row : pending)
+    {
+        writer.write(row.row);
+        writer.write(row.missing);
+    }
+    
+    return writer.commit();
+}
+
+bool CDMissingValueRecovery::loadCheckpoint(const std::string &path)
+{
+    MathIO::CheckpointReader reader(path);
+    
+    if (!reader.isValid())
+    {
+        return false;
+    }
+    
+    // everything is parsed into temporaries first, a checkpoint that can't be read to the end changes nothing
+    arma::mat loadedMatrix;
+    reader.read(loadedMatrix);
+    uint64_t loadedK = reader.readWord();
+    uint64_t loadedFrontier = reader.readWord();
+    uint64_t loadedSinceRefresh = reader.readWord();
+    bool loadedPersistent = reader.readWord() != 0;
+    
+    CentroidDecomposition loadedCd(loadedMatrix);
+    loadedCd.loadState(reader);
+    Algebra::MissingIndex loadedIndex;
+    loadedIndex.loadState(reader);
+    
+    Stats::RunningMoments loadedMoments(loadedMatrix.n_cols);
+    loadedMoments.loadState(reader);
+    uint64_t loadedCounted = reader.readWord();
+    Algebra::MissingIndex loadedRecovered;
+    loadedRecovered.loadState(reader);
+    std::vector<double> loadedValues;
+    reader.read(loadedValues);
+    
+    std::vector<double> loadedSpectrum;
+    reader.read(loadedSpectrum);
+    uint64_t loadedReduction = reader.readWord();
+    
+    std::deque<PendingRow> loadedPending(reader.readLength(2 * sizeof(uint64_t))); // a row and its length at least
+    for (PendingRow &row : loadedPending)
+    {
+        row.row = reader.readWord();
+        reader.read(row.missing);
+    }
+    
+    matrix.swap(loadedMatrix);
+    k = loadedK;
+    streamFrontier = loadedFrontier;
+    rowsSinceRefresh = loadedSinceRefresh;
+    persistentNormalization = loadedPersistent;
+    cd.swapState(loadedCd);
+    missingIndex = std::move(loadedIndex);
+    
+    moments = std::move(loadedMoments);
+    countedRows = loadedCounted;
+    recovered = std::move(loadedRecovered);
+    recoveredValues = std::move(loadedValues);
+    
+    spectrum = std::move(loadedSpectrum);
+    detectedReduction = loadedReduction;
+    pending = std::move(loadedPending);
+    
+    return true;
 }
 
 #define RECOVERY_VERBOSE_
@@ -139,11 +247,12 @@ void CDMissingValueRecovery::increment_raw(uint64_t newrows)
 
 uint64_t CDMissingValueRecovery::performRecovery(bool determineReduction /*= false*/)
 {
-    uint64_t totalMBSize = 0;
+    unrollWindow();
+    uint64_t totalMBSize = missingIndex.cells();
     
-    for (auto mblock : missingBlocks)
+    if (persistentNormalization)
     {
-        totalMBSize += mblock.blockSize;
+        countArrivals();
     }
     
     interpolate();
@@ -155,7 +264,11 @@ uint64_t CDMissingValueRecovery::performRecovery(bool determineReduction /*= fal
     uint64_t iter = 0;
     double delta = 99.0;
     
-    if (useNormalization)
+    if (persistentNormalization)
+    {
+        normalizeMatrix();
+    }
+    else if (useNormalization)
     {
         cm.normalizeMatrix();
     }
@@ -167,155 +280,46 @@ uint64_t CDMissingValueRecovery::performRecovery(bool determineReduction /*= fal
     
     auto centroidValues = std::vector<double>();
     
+    historyF.clear();
+    historyG.clear();
+    lastF.reset();
+    lastG.reset();
+    policy.restart();
+    
     while (++iter <= maxIterations && delta >= epsPrecision)
     {
-        if (optimization > 0)
-        {
-            if (iter != 1)
-            {
-                std::cout << "iteration #" << iter << ", delta=" << delta << std::endl;
-            }
-            
-            bool skipSSV;
-            
-            switch (optimization)
-            {
-                case 100:
-                    this->cd.performDecomposition(&centroidValues, false, false);
-                    break;
-                
-                case 1:
-                case 2:
-                case 3:
-                case 4:
-                case 5:
-                case 6:
-                case 7:
-                    skipSSV = iter >= (optimization + 1);
-                    if (!skipSSV)
-                    { cd.resetSignVectors(); }
-                    this->cd.performDecomposition(&centroidValues, false, skipSSV);
-                    break;
-                
-                case 101:
-                case 102:
-                case 103:
-                case 104:
-                case 105:
-                case 106:
-                case 107:
-                    optimization -= 100;
-                    skipSSV = iter >= (optimization + 1);
-                    this->cd.performDecomposition(&centroidValues, false, skipSSV);
-                    break;
-                
-                case 10:
-                    skipSSV = delta <= 1E-2;
-                    if (!skipSSV)
-                    { cd.resetSignVectors(); }
-                    this->cd.performDecomposition(&centroidValues, false, skipSSV);
-                    break;
-                
-                case 110:
-                    skipSSV = delta <= 1E-2;
-                    this->cd.performDecomposition(&centroidValues, false, skipSSV);
-                    break;
-                
-                case 20:
-                    skipSSV = iter != 1 && iter != 7;
-                    if (!skipSSV)
-                    { cd.resetSignVectors(); }
-                    this->cd.performDecomposition(&centroidValues, false, skipSSV);
-                    break;
-                
-                case 120:
-                    skipSSV = iter != 1 && iter != 7;
-                    this->cd.performDecomposition(&centroidValues, false, skipSSV);
-                    break;
-                
-                case 25:
-                    skipSSV = iter > 3 && iter % 2 == 0; //skips 4, 6, 8 ...
-                    if (!skipSSV)
-                    { cd.resetSignVectors(); }
-                    this->cd.performDecomposition(&centroidValues, false, skipSSV);
-                    break;
-                
-                case 125:
-                    skipSSV = iter > 3 && iter % 2 == 0;
-                    this->cd.performDecomposition(&centroidValues, false, skipSSV);
-                    break;
-                
-                case 301:
-                case 302:
-                case 303:
-                case 304:
-                case 305:
-                case 306:
-                case 307:
-                    optimization -= 300;
-                    if (iter < (optimization + 1))
-                    { cd.resetSignVectors(); }
-                    this->cd.performDecomposition(&centroidValues, false, false);
-                    break;
-                
-                case 310:
-                    if (delta > 1E-2)
-                    { cd.resetSignVectors(); }
-                    this->cd.performDecomposition(&centroidValues, false, false);
-                    break;
-                
-                case 325:
-                    if (iter % 2 == 0)
-                    { cd.resetSignVectors(); }
-                    this->cd.performDecomposition(&centroidValues, false, false);
-                    break;
-                
-                case 330:
-                    if (iter == 1 || iter == 5)
-                    { cd.resetSignVectors(); }
-                    this->cd.performDecomposition(&centroidValues, false, false);
-                    break;
-                
-                case 331:
-                    if (iter == 1 || iter == 4 || iter == 7)
-                    { cd.resetSignVectors(); }
-                    this->cd.performDecomposition(&centroidValues, false, false);
-                    break;
-                
-                default:
-                    std::cout << "Unrecognized optimization type " << optimization << " for RCD";
-                    exit(-1);
-            }
-        }
-        else
+        SignVectorStep step = policy.next(iter, delta);
+        
+        if (step.reset || (disableCaching && policy.schedule == SignVectorSchedule::Cached))
         {
-            if (disableCaching)
-            { cd.resetSignVectors(); }
-            
-            this->cd.performDecomposition(&centroidValues);
+            cd.resetSignVectors();
         }
         
-        const arma::mat &L = cd.getLoad();
-        const arma::mat &R = cd.getRel();
+        this->cd.performDecomposition(&centroidValues, false, !step.search);
+        policy.observe(cd.getFlips());
         
-        arma::mat recover = L * R.t();
+        // x - current values of the missing cells, g = G(x) - their reconstruction
+        arma::vec g(totalMBSize);
+        arma::vec x(totalMBSize);
+        reconstructMissing(g, x);
         
+        arma::vec f = g - x;
         delta = 0.0;
         
-        for (auto mblock : missingBlocks)
+        for (uint64_t c = 0; c < f.n_elem; ++c)
         {
-            for (uint64_t i = mblock.startingIndex; i < mblock.startingIndex + mblock.blockSize; ++i)
-            {
-                double diff = matrix.at(i, mblock.column) - recover.at(i, mblock.column);
-                delta += fabs(diff);
-                
-                matrix.at(i, mblock.column) = recover.at(i, mblock.column);
-                recover.at(i, mblock.column) = 0.0;
-            }
+            delta += fabs(f[c]);
         }
         
         delta = delta / (double)totalMBSize;
         
+        if (acceleration > 0)
+        {
+            accelerate(g, f);
+        }
+        
+        writeMissing(g);
+        
         //lastrecon -= recover;
         
         //delta = arma::norm(lastrecon) / std::sqrt((double)lastrecon.n_rows);
@@ -327,7 +331,12 @@ uint64_t CDMissingValueRecovery::performRecovery(bool determineReduction /*= fal
 #endif
     }
     
-    if (useNormalization)
+    if (persistentNormalization)
+    {
+        denormalizeMatrix();
+        recordRecovered();
+    }
+    else if (useNormalization)
     {
         cm.deNormalizeMatrix();
     }
@@ -336,54 +345,578 @@ uint64_t CDMissingValueRecovery::performRecovery(bool determineReduction /*= fal
     std::cout << "recovery performed in " << lastIterations << " iterations " << std::endl;
     
     // when the recovery is done, we need to clean up some stuff
-    missingBlocks.clear();
+    missingIndex.clear();
+    streamFrontier = matrix.n_rows;
     
     return iter - 1;
 }
 
+// Rows that aren't in the statistics yet, O(m) each.
+void CDMissingValueRecovery::countArrivals()
+{
+    for (uint64_t i = countedRows; i < matrix.n_rows; ++i)
+    {
+        moments.push(matrix, i);
+    }
+    
+    countedRows = matrix.n_rows;
+}
+
+void CDMissingValueRecovery::normalizeMatrix()
+{
+    moments.normalizeRows(matrix, matrix.n_rows);
+}
+
+void CDMissingValueRecovery::denormalizeMatrix()
+{
+    moments.denormalizeRows(matrix, matrix.n_rows);
+}
+
+void CDMissingValueRecovery::normalizeRow(uint64_t i)
+{
+    if (persistentNormalization)
+    {
+        moments.normalizeRow(matrix, i);
+        return;
+    }
+    
+    const std::vector<double> &mean = cm.getMean();
+    const std::vector<double> &stddev = cm.getStddev();
+    
+    for (uint64_t j = 0; j < matrix.n_cols; ++j)
+    {
+        matrix.at(i, j) = (matrix.at(i, j) - mean[j]) / stddev[j];
+    }
+}
+
+void CDMissingValueRecovery::denormalizeRow(uint64_t i)
+{
+    if (persistentNormalization)
+    {
+        moments.denormalizeRow(matrix, i);
+        return;
+    }
+    
+    const std::vector<double> &mean = cm.getMean();
+    const std::vector<double> &stddev = cm.getStddev();
+    
+    for (uint64_t j = 0; j < matrix.n_cols; ++j)
+    {
+        matrix.at(i, j) = (matrix.at(i, j) * stddev[j]) + mean[j];
+    }
+}
+
+void CDMissingValueRecovery::recordRecovered()
+{
+    for (uint64_t b = 0; b < missingIndex.runs(); ++b)
+    {
+        uint64_t col = missingIndex.column(b);
+        uint64_t start = missingIndex.start(b);
+        
+        recovered.add(col, start, missingIndex.size(b));
+        
+        for (uint64_t i = start; i < start + missingIndex.size(b); ++i)
+        {
+            recoveredValues.push_back(matrix.at(i, col));
+        }
+    }
+}
+
+// Only the missing cells of L * R^T are computed; a block is a run of rows in one column, so it's
+// L_[rows]* * R_col*^T, accumulated one component at a time over contiguous columns of L.
+// Cells of all the blocks are laid out one block after another in both vectors.
+void CDMissingValueRecovery::reconstructMissing(arma::vec &recover, arma::vec &current)
+{
+    const arma::mat &L = cd.getLoad();
+    const arma::mat &R = cd.getRel();
+    
+    std::vector<uint64_t> offsets = missingIndex.offsets();
+    
+    #pragma omp parallel for num_threads(cd.threads) schedule(dynamic) if(cd.threads > 1)
+    for (uint64_t b = 0; b < missingIndex.runs(); ++b)
+    {
+        uint64_t col = missingIndex.column(b);
+        uint64_t start = missingIndex.start(b);
+        uint64_t size = missingIndex.size(b);
+        double *block = recover.memptr() + offsets[b];
+        
+        std::fill(block, block + size, 0.0);
+        
+        for (uint64_t l = 0; l < L.n_cols; ++l)
+        {
+            Algebra::Kernels::axpy(R.at(col, l), L.colptr(l) + start, block, size);
+        }
+        
+        std::copy(matrix.colptr(col) + start, matrix.colptr(col) + start + size, current.memptr() + offsets[b]);
+    }
+}
+
+void CDMissingValueRecovery::writeMissing(const arma::vec &values)
+{
+    const double *c = values.memptr();
+    
+    for (uint64_t b = 0; b < missingIndex.runs(); ++b)
+    {
+        uint64_t size = missingIndex.size(b);
+        std::copy(c, c + size, matrix.colptr(missingIndex.column(b)) + missingIndex.start(b));
+        c += size;
+    }
+}
+
+// Anderson mixing over the missing cells: with f = G(x) - x, the next iterate is G(x) - dG * gamma, where gamma
+// makes ||f - dF * gamma|| the smallest over the last <acceleration> differences of f and G(x).
+// Safeguard: if the residual grew, the history is dropped and the plain update G(x) is taken.
+void CDMissingValueRecovery::accelerate(arma::vec &g, const arma::vec &f)
+{
+    if (lastF.n_elem == f.n_elem)
+    {
+        if (arma::dot(f, f) > arma::dot(lastF, lastF))
+        {
+            historyF.clear();
+            historyG.clear();
+        }
+        else
+        {
+            historyF.emplace_back(f - lastF);
+            historyG.emplace_back(g - lastG);
+            
+            if (historyF.size() > acceleration)
+            {
+                historyF.erase(historyF.begin());
+                historyG.erase(historyG.begin());
+            }
+        }
+    }
+    
+    lastF = f;
+    lastG = g;
+    
+    if (historyF.empty())
+    {
+        return;
+    }
+    
+    // normal equations of the least squares, depth x depth
+    uint64_t depth = historyF.size();
+    arma::mat A(depth, depth);
+    arma::vec b(depth);
+    
+    for (uint64_t p = 0; p < depth; ++p)
+    {
+        b[p] = arma::dot(historyF[p], f);
+        
+        for (uint64_t q = 0; q < depth; ++q)
+        {
+            A.at(p, q) = arma::dot(historyF[p], historyF[q]);
+        }
+        
+        A.at(p, p) *= 1.0 + 1E-10; // differences can be close to collinear
+    }
+    
+    arma::vec gamma;
+    
+    if (!arma::solve(gamma, A, b))
+    {
+        return;
+    }
+    
+    for (uint64_t p = 0; p < depth; ++p)
+    {
+        g -= gamma[p] * historyG[p];
+    }
+}
+
+uint64_t CDMissingValueRecovery::performStreamingRecovery(uint64_t rows /*= 0*/)
+{
+    uint64_t last = rows == 0
+                    ? matrix.n_rows
+                    : std::min<uint64_t>(matrix.n_rows, streamFrontier + rows);
+    
+    uint64_t processed = 0;
+    
+    for (; streamFrontier < last; ++streamFrontier)
+    {
+        recoverRow(streamFrontier, streamFrontier > 0 ? streamFrontier - 1 : CentroidDecomposition::minusone);
+        ++processed;
+    }
+    
+    return processed;
+}
+
+void CDMissingValueRecovery::setWindow(uint64_t capacity)
+{
+    cd.setWindow(capacity);
+    streamFrontier = matrix.n_rows;
+}
+
+uint64_t CDMissingValueRecovery::pushRow(const arma::vec &row)
+{
+    // the row either extends the matrix or takes the place of the oldest one in the window
+    uint64_t slot = cd.slideWindow();
+    dropPending(slot); // an evicted row isn't refined anymore
+    missingIndex.rescan(slot); // neither are its missing cells
+    uint64_t n = matrix.n_rows;
+    uint64_t previous = n > 1 ? (slot + n - 1) % n : CentroidDecomposition::minusone;
+    
+    for (uint64_t j = 0; j < matrix.n_cols; ++j)
+    {
+        matrix.at(slot, j) = row[j];
+    }
+    
+    if (persistentNormalization && slot < countedRows)
+    {
+        // a slot of the window was counted with the row it held before, a new one is counted by recoverRow
+        moments.push(matrix, slot);
+    }
+    
+    recoverRow(slot, previous);
+    streamFrontier = n;
+    
+    return slot;
+}
+
+void CDMissingValueRecovery::refreshDecomposition(uint64_t rows /*= 0*/)
+{
+    rows = rows > 0 ? rows : streamFrontier > 0 ? streamFrontier : matrix.n_rows;
+    rows = std::min<uint64_t>(rows, matrix.n_rows);
+    
+    // the rows of the stream that haven't arrived are neither normalized nor decomposed, O(rows * m) per pass
+    if (persistentNormalization)
+    {
+        moments.normalizeRows(matrix, rows);
+    }
+    else if (useNormalization)
+    {
+        cm.normalizeMatrix();
+    }
+    
+    cd.performDecomposition(nullptr, false, false, rows);
+    
+    if (persistentNormalization)
+    {
+        moments.denormalizeRows(matrix, rows);
+    }
+    else if (useNormalization)
+    {
+        cm.deNormalizeMatrix();
+    }
+    
+    rowsSinceRefresh = 0;
+    ++refreshes;
+}
+
+uint64_t CDMissingValueRecovery::getRefreshes()
+{
+    return refreshes;
+}
+
+void CDMissingValueRecovery::recoverRow(uint64_t i, uint64_t previous)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<uint64_t> missing = std::vector<uint64_t>();
+    
+    for (uint64_t j = 0; j < matrix.n_cols; ++j)
+    {
+        if (std::isnan(matrix.at(i, j)))
+        {
+            missing.emplace_back(j);
+        }
+    }
+    
+    bool normalize = useNormalization || persistentNormalization;
+    
+    if (persistentNormalization && i >= countedRows)
+    {
+        moments.push(matrix, i);
+        countedRows = i + 1;
+    }
+    
+    // init: carry the last known value of the series forward, the row is brought into the space of the decomposition
+    for (uint64_t j = 0; j < matrix.n_cols; ++j)
+    {
+        if (std::isnan(matrix.at(i, j)))
+        {
+            matrix.at(i, j) = previous != CentroidDecomposition::minusone ? matrix.at(previous, j) : 0.0;
+        }
+    }
+    
+    if (normalize)
+    {
+        normalizeRow(i);
+    }
+    
+    const arma::mat &L = cd.getLoad();
+    const arma::mat &R = cd.getRel();
+    
+    double residual = 0.0;
+    bool estimated = false;
+    
+    if (foldIn && !missing.empty() && cd.foldInRow(i, missing, residual))
+    {
+        for (uint64_t j : missing)
+        {
+            matrix.at(i, j) = arma::dot(L.row(i), R.row(j));
+        }
+    }
+    else if (!iterateRow(i, missing, start, rowDeadline))
+    {
+        // deadline: fold-in on the last decomposition, if it can't be done the row keeps the iterates it reached
+        if (cd.foldInRow(i, missing, residual))
+        {
+            for (uint64_t j : missing)
+            {
+                matrix.at(i, j) = arma::dot(L.row(i), R.row(j));
+            }
+        }
+        
+        estimated = true;
+    }
+    
+    cd.commitRow(i);
+    
+    if (normalize)
+    {
+        denormalizeRow(i);
+    }
+    
+    if (persistentNormalization)
+    {
+        for (uint64_t j : missing)
+        {
+            recovered.add(j, i, 1);
+            recoveredValues.push_back(matrix.at(i, j));
+        }
+    }
+    
+    ++metrics.rows;
+    
+    if (estimated)
+    {
+        pending.push_back({ i, std::move(missing) });
+        ++metrics.fallbacks;
+    }
+    
+    ++rowsSinceRefresh;
+    uint64_t interval = refreshInterval > 0 ? refreshInterval : cd.getWindow();
+    
+    if ((interval > 0 && rowsSinceRefresh >= interval)
+        || (foldIn && refreshResidual > 0.0 && residual > refreshResidual))
+    {
+        refreshDecomposition(std::max<uint64_t>(streamFrontier, i + 1)); // row i is in, the frontier isn't past it
+    }
+    
+    if (rowDeadline > 0)
+    {
+        // what is left of the tick goes to the rows that were estimated before
+        uint64_t elapsed = elapsedSince(start);
+        
+        if (elapsed > rowDeadline)
+        {
+            ++metrics.overruns;
+        }
+        else if (!pending.empty() && !estimated)
+        {
+            refinePending(rowDeadline - elapsed);
+        }
+    }
+}
+
+// Same fixed point as in the batch recovery, restricted to the cells of a single row. With a deadline (microseconds
+// since start), the iterations stop before the one that would probably cross it; false - stopped that way.
+
+bool CDMissingValueRecovery::iterateRow(uint64_t i, const std::vector<uint64_t> &missing,
+                                        std::chrono::steady_clock::time_point start, uint64_t deadline)
+{
+    const arma::mat &L = cd.getLoad();
+    const arma::mat &R = cd.getRel();
+    
+    uint64_t iter = 0;
+    double delta = 99.0;
+    
+    while (!missing.empty() && ++iter <= maxIterations && delta >= epsPrecision)
+    {
+        if (deadline > 0)
+        {
+            uint64_t elapsed = elapsedSince(start);
+            uint64_t perIteration = iter > 1 ? elapsed / (iter - 1) : 0;
+            
+            if (elapsed + perIteration > deadline)
+            {
+                return false;
+            }
+        }
+        
+        cd.projectRow(i);
+        
+        delta = 0.0;
+        
+        for (uint64_t j : missing)
+        {
+            double recover = arma::dot(L.row(i), R.row(j));
+            delta += fabs(matrix.at(i, j) - recover);
+            matrix.at(i, j) = recover;
+        }
+        
+        delta = delta / (double)missing.size();
+    }
+    
+    return true;
+}
+
+uint64_t CDMissingValueRecovery::refinePending(uint64_t budget /*= 0*/)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint64_t refined = 0;
+    
+    while (!pending.empty() && (budget == 0 || elapsedSince(start) < budget))
+    {
+        PendingRow row = std::move(pending.front());
+        pending.pop_front();
+        
+        uint64_t i = row.row;
+        bool normalize = useNormalization || persistentNormalization;
+        
+        if (normalize)
+        {
+            normalizeRow(i);
+        }
+        
+        // the row leaves the decomposition while it's iterated on, as it does when it's evicted from the window
+        cd.retractRow(i);
+        
+        bool done = iterateRow(i, row.missing, start, budget);
+        cd.commitRow(i);
+        
+        if (normalize)
+        {
+            denormalizeRow(i);
+        }
+        
+        for (uint64_t j : row.missing)
+        {
+            if (done && issueCorrections)
+            {
+                corrections.push_back({ i, j, matrix.at(i, j) });
+            }
+            
+            if (done && persistentNormalization)
+            {
+                recovered.add(j, i, 1);
+                recoveredValues.push_back(matrix.at(i, j));
+            }
+        }
+        
+        if (!done)
+        {
+            // out of budget, it goes on from where it stopped next time
+            pending.push_front(std::move(row));
+            break;
+        }
+        
+        ++refined;
+        ++metrics.refined;
+        metrics.corrections += row.missing.size();
+    }
+    
+    return refined;
+}
+
+std::vector<CorrectionRecord> CDMissingValueRecovery::takeCorrections()
+{
+    std::vector<CorrectionRecord> res = std::move(corrections);
+    corrections.clear();
+    return res;
+}
+
+void CDMissingValueRecovery::dropPending(uint64_t i)
+{
+    for (auto it = pending.begin(); it != pending.end();)
+    {
+        it = it->row == i ? pending.erase(it) : it + 1;
+    }
+}
+
+void CDMissingValueRecovery::unrollWindow()
+{
+    uint64_t n = matrix.n_rows;
+    uint64_t shift = cd.unrollWindow();
+    
+    if (shift == 0)
+    {
+        return;
+    }
+    
+    missingIndex.rotate(shift, n);
+    recovered.rotate(shift, n);
+    
+    for (PendingRow &row : pending)
+    {
+        row.row = (row.row + n - shift) % n;
+    }
+    
+    for (CorrectionRecord &c : corrections)
+    {
+        c.row = (c.row + n - shift) % n;
+    }
+}
+
+uint64_t CDMissingValueRecovery::elapsedSince(std::chrono::steady_clock::time_point start)
+{
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
 void CDMissingValueRecovery::interpolate()
 {
     // init missing blocks
-    for (auto mblock : missingBlocks)
+    for (uint64_t b = 0; b < missingIndex.runs(); ++b)
     {
+        uint64_t col = missingIndex.column(b);
+        uint64_t start = missingIndex.start(b);
+        uint64_t size = missingIndex.size(b);
+        
         // linear interpolation
         double val1 = NAN, val2 = NAN;
-        if (mblock.startingIndex > 0)
+        if (start > 0)
         {
-            val1 = matrix.at(mblock.startingIndex - 1, mblock.column);
+            val1 = matrix.at(start - 1, col);
         }
-        if (mblock.startingIndex + mblock.blockSize < matrix.n_rows)
+        if (start + size < matrix.n_rows)
         {
-            val2 = matrix.at(mblock.startingIndex + mblock.blockSize, mblock.column);
+            val2 = matrix.at(start + size, col);
         }
         
         double step;
         
         // fallback case - no 2nd value for interpolation or block is too big to interpolate it
-        if (std::isnan(val1) || std::isnan(val2) || mblock.blockSize * 4 >= matrix.n_rows)
+        if (std::isnan(val1) || std::isnan(val2) || size * 4 >= matrix.n_rows)
         {
             val1 = 0.0;
             step = 0;
         }
         else
         {
-            step = (val2 - val1) / (double)(mblock.blockSize + 1);
+            step = (val2 - val1) / (double)(size + 1);
         }
         
-        for (uint64_t i = 0; i < mblock.blockSize; ++i)
+        for (uint64_t i = 0; i < size; ++i)
         {
-            matrix.at(mblock.startingIndex + i, mblock.column) = val1 + step * (double)(i + 1);
+            matrix.at(start + i, col) = val1 + step * (double)(i + 1);
         }
     }
 }
 
 void CDMissingValueRecovery::init_zero()
 {
-    for (auto mblock : missingBlocks)
+    for (uint64_t b = 0; b < missingIndex.runs(); ++b)
     {
-        for (uint64_t i = 0; i < mblock.blockSize; ++i)
+        uint64_t col = missingIndex.column(b);
+        uint64_t start = missingIndex.start(b);
+        uint64_t size = missingIndex.size(b);
+        
+        for (uint64_t i = 0; i < size; ++i)
         {
-            matrix.at(mblock.startingIndex + i, mblock.column) = 0.0;
+            matrix.at(start + i, col) = 0.0;
         }
     }
 }
@@ -407,11 +940,15 @@ void CDMissingValueRecovery::init_mean()
         means[j] /= (double)count;
     }
     
-    for (auto mblock : missingBlocks)
+    for (uint64_t b = 0; b < missingIndex.runs(); ++b)
     {
-        for (uint64_t i = 0; i < mblock.blockSize; ++i)
+        uint64_t col = missingIndex.column(b);
+        uint64_t start = missingIndex.start(b);
+        uint64_t size = missingIndex.size(b);
+        
+        for (uint64_t i = 0; i < size; ++i)
         {
-            matrix.at(mblock.startingIndex + i, mblock.column) = means[mblock.column];
+            matrix.at(start + i, col) = means[col];
         }
     }
 }
@@ -435,11 +972,15 @@ void CDMissingValueRecovery::init_mean_horiz()
         means[i] /= (double)count;
     }
     
-    for (auto mblock : missingBlocks)
+    for (uint64_t b = 0; b < missingIndex.runs(); ++b)
     {
-        for (uint64_t i = 0; i < mblock.blockSize; ++i)
+        uint64_t col = missingIndex.column(b);
+        uint64_t start = missingIndex.start(b);
+        uint64_t size = missingIndex.size(b);
+        
+        for (uint64_t i = 0; i < size; ++i)
         {
-            matrix.at(mblock.startingIndex + i, mblock.column) = means[mblock.column];
+            matrix.at(start + i, col) = means[col];
         }
     }
 }
@@ -447,16 +988,20 @@ void CDMissingValueRecovery::init_mean_horiz()
 void CDMissingValueRecovery::init_1NN()
 {
     // init missing blocks
-    for (auto mblock : missingBlocks)
+    for (uint64_t b = 0; b < missingIndex.runs(); ++b)
     {
+        uint64_t col = missingIndex.column(b);
+        uint64_t start = missingIndex.start(b);
+        uint64_t size = missingIndex.size(b);
+        
         double val1 = NAN, val2 = NAN;
-        if (mblock.startingIndex > 0)
+        if (start > 0)
         {
-            val1 = matrix.at(mblock.startingIndex - 1, mblock.column);
+            val1 = matrix.at(start - 1, col);
         }
-        if (mblock.startingIndex + mblock.blockSize < matrix.n_rows)
+        if (start + size < matrix.n_rows)
         {
-            val2 = matrix.at(mblock.startingIndex + mblock.blockSize, mblock.column);
+            val2 = matrix.at(start + size, col);
         }
         
         // fallback case - no 2nd value for interpolation
@@ -473,11 +1018,11 @@ void CDMissingValueRecovery::init_1NN()
             val2 = val1;
         }
         
-        uint64_t split = mblock.blockSize / 2;
+        uint64_t split = size / 2;
         
-        for (uint64_t i = 0; i < mblock.blockSize; ++i)
+        for (uint64_t i = 0; i < size; ++i)
         {
-            matrix.at(mblock.startingIndex + i, mblock.column) = (i <= split) ? val1 : val2;
+            matrix.at(start + i, col) = (i <= split) ? val1 : val2;
         }
     }
 }
@@ -485,7 +1030,33 @@ void CDMissingValueRecovery::init_1NN()
 void CDMissingValueRecovery::determineReduction()
 {
 #ifdef determine_reduction_nonstat
-    // step 1 - do full CD to determine rank
+    // step 0 - cd starts from the sign vectors its last decomposition found, the spectrum they give on the current
+    // matrix without a search is compared with the one of the last detection
+    if (detectedReduction > 0 && reductionDrift > 0.0)
+    {
+        std::vector<double> current;
+        current.reserve(matrix.n_cols);
+        cd.centroidSpectrum(current);
+        
+        double drift = 0.0;
+        
+        for (uint64_t i = 0; i < std::min(current.size(), spectrum.size()); ++i)
+        {
+            current[i] /= (double)matrix.n_rows;
+            drift = std::max(drift, std::fabs(current[i] - spectrum[i]));
+        }
+        
+        double contributionSum, entropy;
+        
+        if (current.size() == spectrum.size() && drift <= reductionDrift * spectrum[0]
+            && entropyReduction(current, contributionSum, entropy) == detectedReduction)
+        {
+            setReduction(detectedReduction);
+            return;
+        }
+    }
+    
+    // step 1 - do full CD to determine rank, the searches start from the sign vectors of the last one
     
     std::vector<double> centroidValues = std::vector<double>();
     centroidValues.reserve(matrix.n_cols);
@@ -494,41 +1065,18 @@ void CDMissingValueRecovery::determineReduction()
     
     uint64_t rank = centroidValues.size();
     
-    double squaresum = 0.0;
-    
     std::cout << "CValues (rank=" << rank << "): ";
     for (auto &a : centroidValues)
     {
         a /= (double)matrix.n_rows;
-        squaresum += a * a;
         std::cout << a << " ";
     }
     std::cout << std::endl;
     
     // step 2 [ALT] - entropy
     
-    std::vector<double> relContribution = std::vector<double>();
-    relContribution.reserve(rank);
-    for (auto a : centroidValues)
-    {
-        relContribution.emplace_back(a * a / squaresum);
-    }
-    
-    double entropy = 0.0;
-    for (auto a : relContribution)
-    {
-        entropy += a * std::log(a);
-    }
-    entropy /= -std::log(rank);
-    
-    uint64_t red;
-    double contributionSum = relContribution[0];
-    for (red = 1; red < rank - 1; ++red)
-    {
-        if (contributionSum >= entropy)
-        { break; }
-        contributionSum += relContribution[red];
-    }
+    double contributionSum, entropy;
+    uint64_t red = entropyReduction(centroidValues, contributionSum, entropy);
     
     std::cout << "Auto-reduction [entropy] detected as: "
               << red << " in [1..." << rank - 1 << "]," << std::endl
@@ -537,23 +1085,26 @@ void CDMissingValueRecovery::determineReduction()
     
     // cleanup - we will have less dimensions later
     cd.destroyDecomposition();
+    
+    spectrum = std::move(centroidValues);
+    detectedReduction = red;
 #else
     
     Stats::CorrelationMatrix cm(matrix);
-
+        
         //cm.normalizeMatrix();
-
+        
         Matrix *cormat = cm.getCorrelationMatrix();
-
+        
         std::cout << "Corr(X) =" << std::endl << cormat->toString() << std::endl;
-
+        
         Vector *sigma = cm.getSingularValuesOfCM();
-
+        
         std::cout << "Sigma(Corr(X)) =" << sigma->toString() << std::endl;
-
+        
         uint64_t rank = 0;
         double squaresum = 0.0;
-
+        
         for (uint64_t i = 0; i < sigma->_dim(); ++i)
         {
             if ((*sigma)[i] < CentroidDecomposition::eps)
@@ -567,7 +1118,7 @@ void CDMissingValueRecovery::determineReduction()
             }
         }
         if (rank == 0) rank = sigma->_dim();
-
+        
         std::vector<double> relContribution = std::vector<double>();
         relContribution.reserve(rank);
         for (uint64_t i = 0; i < sigma->_dim(); ++i)
@@ -575,14 +1126,14 @@ void CDMissingValueRecovery::determineReduction()
             double a = (*sigma)[i];
             relContribution.emplace_back(a*a / squaresum);
         }
-
+        
         double entropy = 0.0;
         for (auto a : relContribution)
         {
             entropy += a * std::log(a);
         }
         entropy /= -std::log(rank);
-
+        
         uint64_t red;
         double contributionSum = relContribution[0];
         for (red = 1; red < rank - 1; ++red)
@@ -590,7 +1141,7 @@ void CDMissingValueRecovery::determineReduction()
             if (contributionSum >= entropy) { break; }
             contributionSum += relContribution[red];
         }
-
+        
         std::cout << "Auto-reduction [entropy] detected as: "
                   << red << " in [1..." << rank-1 << "], with  sum(contrib)=" << contributionSum
                   << " entropy=" << entropy << std::endl << std::endl;
@@ -599,6 +1150,43 @@ void CDMissingValueRecovery::determineReduction()
     setReduction(red);
 }
 
+uint64_t CDMissingValueRecovery::entropyReduction(const std::vector<double> &centroidValues, double &contributionSum,
+                                                  double &entropy)
+{
+    uint64_t rank = centroidValues.size();
+    
+    double squaresum = 0.0;
+    for (auto a : centroidValues)
+    {
+        squaresum += a * a;
+    }
+    
+    std::vector<double> relContribution = std::vector<double>();
+    relContribution.reserve(rank);
+    for (auto a : centroidValues)
+    {
+        relContribution.emplace_back(a * a / squaresum);
+    }
+    
+    entropy = 0.0;
+    for (auto a : relContribution)
+    {
+        entropy += a * std::log(a);
+    }
+    entropy /= -std::log(rank);
+    
+    uint64_t red;
+    contributionSum = relContribution[0];
+    for (red = 1; red < rank - 1; ++red)
+    {
+        if (contributionSum >= entropy)
+        { break; }
+        contributionSum += relContribution[red];
+    }
+    
+    return red;
+}
+
 void CDMissingValueRecovery::RecoverMatrix(arma::mat &matrix, uint64_t k, double eps)
 {
     CDMissingValueRecovery rmv(matrix, 100, eps);
@@ -608,5 +1196,52 @@ void CDMissingValueRecovery::RecoverMatrix(arma::mat &matrix, uint64_t k, double
     rmv.performRecovery(k == 0);
 }
 
+//
+// CDStreamingImputer
+//
+
+CDStreamingImputer::CDStreamingImputer(uint64_t k, uint64_t threads)
+        : k(k), threads(threads)
+{ }
+
+CDMissingValueRecovery &CDStreamingImputer::prepare(const arma::mat &history)
+{
+    window = history;
+    recovery.reset(new CDMissingValueRecovery(window));
+    
+    recovery->setReduction(k);
+    recovery->setThreads(threads);
+    return *recovery;
+}
+
+void CDStreamingImputer::warmUp(arma::mat &history)
+{
+    if (!recovery)
+    {
+        prepare(history);
+    }
+    
+    recovery->autoDetectMissingBlocks();
+    recovery->performRecovery(k == history.n_cols);
+    recovery->setWindow(window.n_rows);
+    
+    history = window;
+}
+
+void CDStreamingImputer::pushRow(arma::vec &row)
+{
+    uint64_t slot = recovery->pushRow(row);
+    
+    for (uint64_t j = 0; j < window.n_cols; ++j)
+    {
+        row[j] = window.at(slot, j);
+    }
+}
+
+CDMissingValueRecovery &CDStreamingImputer::getRecovery()
+{
+    return *recovery;
+}
+
 
 } // namespace Algorithms
@@ -5,14 +5,38 @@
 #pragma once
 
 #include <cmath>
+#include <chrono>
+#include <deque>
+#include <memory>
 
 #include "../Algebra/CentroidDecomposition.h"
 #include "../Algebra/MissingBlock.hpp"
+#include "../Algebra/MissingIndex.h"
 #include "../Stats/Correlation.h"
+#include "../Stats/RunningMoments.h"
+#include "SignVectorPolicy.h"
+#include "StreamingImputer.h"
 
 namespace Algorithms
 {
 
+// a streamed cell that was emitted as an estimate, with its refined value (original scale)
+struct CorrectionRecord
+{
+    uint64_t row;
+    uint64_t col;
+    double value;
+};
+
+struct StreamingMetrics
+{
+    uint64_t rows = 0; // streamed
+    uint64_t fallbacks = 0; // rows emitted with an estimate because of the deadline
+    uint64_t refined = 0; // of those, refined afterwards
+    uint64_t corrections = 0; // cells, corrections issued
+    uint64_t overruns = 0; // rows that took longer than the deadline anyway
+};
+
 class CDMissingValueRecovery
 {
     //
@@ -28,11 +52,42 @@ class CDMissingValueRecovery
     const uint64_t maxIterations;
     uint64_t lastIterations = 0;
     double epsPrecision;
-    std::vector<MissingBlock> missingBlocks;
+    Algebra::MissingIndex missingIndex; // cells to recover, shared by all the loops over them
+    
+    SignVectorPolicy policy; // when the iterations repeat the sign vector search
+    bool disableCaching = false; // cached policy only: every search starts from Z = 1
+    bool useNormalization = false; // every recovery normalizes the whole matrix and denormalizes it afterwards
+    
+    // the statistics are running ones, every row is added to them once, when it arrives, instead of being computed over
+    // the whole matrix by every recovery; the matrix is in the original scale between calls: a full decomposition
+    // normalizes all of it, a streamed row is normalized on its own [overrides the above]
+    // what's left are two passes over the rows a decomposition covers, O(n * m) each: performRecovery() normalizes
+    // and denormalizes the whole matrix once, a refresh the rows that have arrived; next to the decomposition itself
+    // they are small, but not free (~10% of a refresh of 1000 x 20 at k = 3)
+    bool persistentNormalization = false;
     
-    uint64_t optimization = 0;
-    bool disableCaching = false;
-    bool useNormalization = false;
+    // auto-reduction: the centroid values the sign vectors of the last detection give on the current matrix are
+    // compared with the ones it had; the detected reduction is kept if none of them moved by more than that (relative
+    // to the first one) and their entropy cutoff is the same, otherwise it's detected again; 0 - detected on every call
+    // the check itself isn't free: it's m deflations from the cached sign vectors (no search), a detection that follows
+    // it still does all m with a search
+    double reductionDrift = 0.2;
+    
+    uint64_t acceleration = 0; // > 0 - Anderson mixing over that many past iterations, 0 - plain fixed point
+    
+    // streamed rows are imputed by fold-in (least squares on the observed entries against Rel) instead of the fixed
+    // point; the decomposition (Rel included) is refreshed every refreshInterval streamed rows (0 - not on a schedule,
+    // except for a window, which is refreshed every time it turned over) and, with fold-in, after a row whose relative
+    // fold-in residual is above refreshResidual (0 - never)
+    bool foldIn = false;
+    uint64_t refreshInterval = 0;
+    double refreshResidual = 0.0;
+    
+    // microseconds per streamed row, 0 - none; a row that won't make it is emitted with an estimate (fold-in on the
+    // last decomposition) and refined with the time other rows leave unused, refining issues correction records
+    uint64_t rowDeadline = 0;
+    bool issueCorrections = true; // false - nobody takes the records, refined cells are only written into the matrix
+    StreamingMetrics metrics;
     
     //
     // Constructors & desctructors
@@ -50,12 +105,28 @@ class CDMissingValueRecovery
     
     void passSignVectorStrategy(CDSignVectorStrategy_2 strategy);
     
+    void passGramCache(uint64_t bytes);
+    
+    void setSearchBudget(uint64_t maxSweeps, uint64_t maxFlips, uint64_t timeBudget);
+    
+    uint64_t getTruncatedSearches();
+    
+    void setThreads(uint64_t threads);
+    
+    void setImplicitDeflation(bool implicit);
+    
     void addMissingBlock(uint64_t col, uint64_t start, uint64_t size);
     
     void addMissingBlock(MissingBlock mb);
     
+    // scans the rows appended since the last call (the detection frontier is missingIndex.scannedRows()) and the ones
+    // passed to rescanRows or overwritten by pushRow since then
     void autoDetectMissingBlocks(double val = NAN);
     
+    // rows that were changed after they were scanned, e.g. new missing values in a matrix that was recovered before;
+    // the missing cells they had are forgotten
+    void rescanRows(uint64_t first, uint64_t count = 1);
+    
     void decomposeOnly();
     
     void increment(const std::vector<double> &vec);
@@ -64,12 +135,107 @@ class CDMissingValueRecovery
     
     void increment_raw(uint64_t newrows);
     
+    // the statistics of persistent normalization stop following the new rows
+    void lockNormalization(bool locked = true);
+    
+    const Stats::RunningMoments &getMoments() const;
+    
+    const Algebra::MissingIndex &getMissingIndex() const;
+    
+    // persistent normalization: cells recovered since the last call are written into out as well, for a caller that
+    // keeps its own copy of the matrix
+    void exportRecovered(arma::mat &out);
+    
+    // the matrix, the decomposition and everything the streaming recovery carries between rows; the settings (policy,
+    // budgets, threads, ...) are not saved, they are the caller's to pass again, neither are metrics and the correction
+    // records that weren't taken
+    bool saveCheckpoint(const std::string &path) const;
+    
+    // the matrix is resized to the saved one; false - no checkpoint or a different version, std::runtime_error - a
+    // truncated or inconsistent one; nothing is changed unless the whole checkpoint was read
+    bool loadCheckpoint(const std::string &path);
+    
     uint64_t performRecovery(bool determineReduction = false);
     
+    uint64_t performStreamingRecovery(uint64_t rows = 0);
+    
+    // rows pushed past the capacity take the slots of the oldest ones; detection and recovery over the whole window
+    // bring the rows back into their arrival order first, row indices given out before that are stale then
+    void setWindow(uint64_t capacity);
+    
+    uint64_t pushRow(const arma::vec &row);
+    
+    // full decomposition of the rows that have arrived, [0, rows) (0 - up to the stream frontier, all of them if
+    // nothing was streamed), as they are: the missing cells keep their values
+    void refreshDecomposition(uint64_t rows = 0);
+    
+    uint64_t getRefreshes();
+    
+    // rows that were emitted as estimates, oldest first, for at most budget microseconds (0 - all of them)
+    uint64_t refinePending(uint64_t budget = 0);
+    
+    // correction records issued since the last call
+    std::vector<CorrectionRecord> takeCorrections();
+    
     //
     // Algorithm
     //
   private:
+    uint64_t streamFrontier = 0;
+    uint64_t rowsSinceRefresh = 0;
+    uint64_t refreshes = 0;
+    
+    Stats::RunningMoments moments;
+    uint64_t countedRows = 0; // rows [0, countedRows) are in the statistics
+    Algebra::MissingIndex recovered; // persistent normalization: not exported yet
+    std::vector<double> recoveredValues;
+    
+    void countArrivals();
+    
+    // the whole matrix into the space of the decomposition and back, running statistics
+    void normalizeMatrix();
+    
+    void denormalizeMatrix();
+    
+    // the same for one row, with the statistics of the normalization in use
+    void normalizeRow(uint64_t i);
+    
+    void denormalizeRow(uint64_t i);
+    
+    void recordRecovered();
+    
+    void recoverRow(uint64_t i, uint64_t previous);
+    
+    bool iterateRow(uint64_t i, const std::vector<uint64_t> &missing,
+                    std::chrono::steady_clock::time_point start, uint64_t deadline);
+    
+    struct PendingRow
+    {
+        uint64_t row;
+        std::vector<uint64_t> missing;
+    };
+    
+    std::deque<PendingRow> pending;
+    std::vector<CorrectionRecord> corrections;
+    
+    void dropPending(uint64_t i);
+    
+    // the window in arrival order, with everything that refers to its rows
+    void unrollWindow();
+    
+    static uint64_t elapsedSince(std::chrono::steady_clock::time_point start);
+    
+    std::vector<arma::vec> historyF;
+    std::vector<arma::vec> historyG;
+    arma::vec lastF;
+    arma::vec lastG;
+    
+    void reconstructMissing(arma::vec &recover, arma::vec &current);
+    
+    void writeMissing(const arma::vec &values);
+    
+    void accelerate(arma::vec &g, const arma::vec &f);
+    
     void interpolate();
     
     void init_zero();
@@ -80,12 +246,45 @@ class CDMissingValueRecovery
     
     void init_1NN();
     
+    std::vector<double> spectrum; // centroid values / n of the last detection
+    uint64_t detectedReduction = 0;
+    
     void determineReduction();
     
+    // entropy cutoff of centroid values / n
+    static uint64_t entropyReduction(const std::vector<double> &centroidValues, double &contributionSum,
+                                     double &entropy);
+    
     //
     // Static
     //
   public:
     static void RecoverMatrix(arma::mat &matrix, uint64_t k = 0, double eps = 1E-6);
 };
+
+// ORBITS row streaming over a window as long as the history (see CDMissingValueRecovery::pushRow)
+class CDStreamingImputer : public StreamingImputer
+{
+  private:
+    arma::mat window;
+    std::unique_ptr<CDMissingValueRecovery> recovery; // exists after the warm-up, it needs the history to be built on
+    uint64_t k;
+    uint64_t threads;
+  
+  public:
+    // k equal to the amount of columns - detected on the history
+    explicit CDStreamingImputer(uint64_t k, uint64_t threads = 1);
+    
+    // builds the recovery on a copy of the history without recovering it, so the settings that the warm-up already
+    // depends on (policy, normalization, ...) can be changed; warmUp() then recovers that copy, whatever it's given
+    CDMissingValueRecovery &prepare(const arma::mat &history);
+    
+    void warmUp(arma::mat &history) override;
+    
+    void pushRow(arma::vec &row) override;
+    
+    // streaming settings (fold-in, deadline, ...) can be changed here after the warm-up
+    CDMissingValueRecovery &getRecovery();
+};
+
 } // namespace Algorithms
@@ -99,7 +99,7 @@ void Algorithms::GROUSE::doGROUSE()
             {
                 double norm_p = arma::norm(p);
                 double theta = std::atan(norm_residual/norm_p); //r_norm/p_norm
-    
+                
                 arma::vec compA = (std::cos(theta) - 1.0) * p / norm_p;
                 arma::vec compB = std::sin(theta) * residual / norm_residual;
                 arma::vec compC = weights / norm_p; // \|w\|_2 = \|p\|_2
@@ -107,7 +107,7 @@ void Algorithms::GROUSE::doGROUSE()
                 arma::rowvec compC_T = compC.t();
                 
                 arma::mat out_AC = compA * compC_T;
-    
+                
                 auto i = idx.begin();
                 uint64_t iouter = 0;
                 for ( ; i < idx.end(); ++i, ++iouter)
@@ -120,7 +120,7 @@ void Algorithms::GROUSE::doGROUSE()
                 //U = U + out_AC;
                 
                 arma::mat out_BC = compB * compC_T;
-    
+                
                 //U[Omega, :] += np.outer(compB, compC)
                 i = idx.begin();
                 iouter = 0;
@@ -174,12 +174,19 @@ void Algorithms::GROUSE::doGROUSE()
 }
 
 void GROUSE::singleRowIncrementSAGE()
+{
+    const uint64_t i = lastIndex;
+    arma::vec v_t = input.col(i); // new vector
+    
+    incrementSAGE(v_t);
+    input.col(i) = v_t;
+}
+
+void GROUSE::incrementSAGE(arma::vec &v_t)
 {
     // basic input: U, R^T, s.t. X = U*R^T, vector with new values
     
-    const uint64_t i = lastIndex; // last idx, single inc only, so no modifications within one call
-    arma::uvec Omega_t = arma::find_finite(input.col(i)); // not int the list like it was in grouse, calculate now
-    arma::vec v_t = input.col(i); // new vector
+    arma::uvec Omega_t = arma::find_finite(v_t); // not int the list like it was in grouse, calculate now
     
     // --- preprocessing ---
     // compute remaining input for SAGE with typical grouse step, for docs see above
@@ -210,12 +217,12 @@ void GROUSE::singleRowIncrementSAGE()
     if (Omega_t.n_elem != v_t.n_elem)
     {
         arma::vec impute = U * weights;
-    
+        
         for (uint64_t j = 0; j < v_t.n_elem; ++j)
         {
-            if (std::isnan(input.at(j, i)))
+            if (std::isnan(v_t[j]))
             {
-                input.at(j, i) = impute[j];
+                v_t[j] = impute[j];
             }
         }
     }
@@ -250,7 +257,12 @@ void GROUSE::singleRowIncrementSAGE()
     U_Omega = U_Omega * U_svd;
     U.rows(Omega_t) = U_Omega;
     
-    // step 3 : perform update on R
+    // step 3 : perform update on R, rows older than the window are dropped first
+    
+    if (rWindow > 0 && R.n_rows >= rWindow)
+    {
+        R.shed_rows(0, R.n_rows - rWindow);
+    }
     
     Algebra::Operations::add_matrix_col(R, arma::zeros<arma::mat>(R.n_rows)); // add a column of 0
     Algebra::Operations::increment_matrix(R, Algebra::Predefined::canonical_vector(R.n_cols, R.n_cols - 1)); // add a row of 0 ... 0 1
@@ -259,9 +271,31 @@ void GROUSE::singleRowIncrementSAGE()
     
     // step 4 : recover missing values in new data
     
-    arma::vec newdata = U * R.row(i).t();
+    arma::vec newdata = U * R.row(R.n_rows - 1).t();
     
     lastIndex++;
 }
 
+//
+// SAGEStreamingImputer
+//
+
+SAGEStreamingImputer::SAGEStreamingImputer(uint64_t k)
+        : k(k)
+{ }
+
+void SAGEStreamingImputer::warmUp(arma::mat &history)
+{
+    input = history.t();
+    grouse.reset(new GROUSE(input, k));
+    grouse->rWindow = 1; // the imputation only needs U
+    grouse->doGROUSE();
+    history = input.t();
+}
+
+void SAGEStreamingImputer::pushRow(arma::vec &row)
+{
+    grouse->incrementSAGE(row);
+}
+
 } // namespace Algorithms
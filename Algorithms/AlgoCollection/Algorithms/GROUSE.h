@@ -4,8 +4,11 @@
 
 #pragma once
 
+#include <memory>
 #include <armadillo>
 
+#include "StreamingImputer.h"
+
 namespace Algorithms
 {
 
@@ -22,14 +25,36 @@ class GROUSE
   public:
     explicit GROUSE(arma::mat &_input, uint64_t _maxrank);
     
+    // rows of R kept by incrementSAGE, the oldest ones are dropped; 0 - all of them, every step costs O(rows * k^2)
+    uint64_t rWindow = 0;
+  
   public:
     void doGROUSE();
     void singleRowIncrementSAGE();
+    
+    // SAGE step on a new vector which isn't in the input, its missing values are imputed in place
+    void incrementSAGE(arma::vec &v_t);
   
   private:
     static constexpr uint64_t maxCycles = 5;
     static constexpr double step_size = 0.1;
 };
 
+// GROUSE on the (transposed) history, then a SAGE step per row
+class SAGEStreamingImputer : public StreamingImputer
+{
+  private:
+    uint64_t k;
+    arma::mat input; // history, series are rows
+    std::unique_ptr<GROUSE> grouse; // refers to input
+  
+  public:
+    explicit SAGEStreamingImputer(uint64_t k);
+    
+    void warmUp(arma::mat &history) override;
+    
+    void pushRow(arma::vec &row) override;
+};
+
 } // namespace Algorithms
 
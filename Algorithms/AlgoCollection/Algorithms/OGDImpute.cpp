@@ -2,6 +2,10 @@
 // Created by zakhar on 17/05/19.
 //
 
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
 #include "OGDImpute.h"
 
 namespace Algorithms
@@ -32,16 +36,47 @@ void OGDImpute::ARPredict()
     }
 }
 
-arma::vec OGDImpute::coeff_lmse_retrain(uint64_t j, uint64_t i)
+double OGDImpute::step(const double *past, double &value, double *coeff, const std::vector<double> &ballK, uint64_t t)
 {
-    arma::vec past_vec = ((arma::vec)matrix.col(j)).subvec(arma::span(i - p, i - 1));
-    arma::mat autocorr = past_vec * past_vec.t();
+    const uint64_t p = ballK.size();
+    
+    double predict = 0.0;
+    for (uint64_t k = 0; k < p; ++k)
+    {
+        predict += past[p - k - 1] * coeff[k];
+    }
+    
+    if (std::isnan(value))
+    {
+        value = predict;
+        return 0.0;
+    }
     
-    arma::vec rxx = past_vec * matrix.at(i, j);
+    double learning_rate = 1 / sqrt((double)t);
     
-    arma::vec coeff = arma::pinv(autocorr) * rxx;
+    // coefficients retrained by least squares: pinv(v * v^T) * v * x with v - the past values; for the rank-1 matrix
+    // that is v * x / ||v||^2, no need for an SVD
+    double norm2 = 0.0;
+    for (uint64_t k = 0; k < p; ++k)
+    {
+        norm2 += past[k] * past[k];
+    }
+    
+    // update alpha
+    for (uint64_t k = 0; k < p; ++k)
+    {
+        double new_coeff = norm2 > 0.0 ? past[k] * value / norm2 : 0.0;
+        double gradient = new_coeff - coeff[k];
+        
+        if (!std::isfinite(gradient))
+        {
+            continue;
+        }
+        
+        coeff[k] = std::min(std::max(coeff[k] + learning_rate * gradient, -ballK[k]), ballK[k]);
+    }
     
-    return coeff;
+    return value - predict; //grad(l_t(Xt,matrix^ar_t(a^t)))
 }
 
 //#define _OGD_IMPUTE_VERBOSE
@@ -63,72 +98,17 @@ void OGDImpute::OGDImpute_call(arma::mat &X, uint64_t j)
     
     for (uint64_t i = std::max(p, lastIdx); i < X.n_rows; ++i)
     {
-        if (std::isnan(X.at(i, j)))
-        {
-            double predict_i = 0.0;
-            for (uint64_t k = 0; k < p; ++k)
-            {
-                predict_i += X.at(i - k - 1, j) * coeff[k];
-            }
-            #ifdef _OGD_IMPUTE_VERBOSE
-            std::cout << "predicted[missing]=" << predict_i << std::endl;
-            #endif
-            X.at(i, j) = predict_i;
-        }
-        else
+        bool missing = std::isnan(X.at(i, j));
+        double diff = step(X.colptr(j) + (i - p), X.at(i, j), coeff.memptr(), ballK, i);
+        
+        #ifdef _OGD_IMPUTE_VERBOSE
+        std::cout << "step " << i << (missing ? " [missing]" : "") << ": value=" << X.at(i, j) << "; diff=" << diff << std::endl;
+        #endif
+        
+        if (!missing)
         {
-            double learning_rate = 1 / sqrt((double)i);
-            
-            double predict_i = 0.0;
-            for (uint64_t k = 0; k < p; ++k)
-            {
-                predict_i += X.at(i - k - 1, j) * coeff[k];
-            }
-            double diff = (X.at(i, j) - predict_i); //grad(l_t(Xt,matrix^ar_t(a^t)))
             noisestd += diff * diff;
             nonmissing_cnt++;
-            
-            #ifdef _OGD_IMPUTE_VERBOSE
-            std::cout << "step " << i << std::endl;
-            std::cout << "[pre]  predicted=" << predict_i << "; real=" << X.at(i, j) << "; diff=" << diff << std::endl;
-            #endif
-    
-            arma::vec new_coeff = coeff_lmse_retrain(j, i);
-            
-            // update alpha
-            for (uint64_t k = 0; k < p; ++k)
-            {
-                double gradient = new_coeff[k] - coeff[k];
-                
-                if (!arma::is_finite(gradient))
-                {
-                    continue;
-                }
-                
-                coeff[k] += learning_rate * gradient;
-                
-                if (coeff[k] >= ballK[k])
-                {
-                    coeff[k] = ballK[k];
-                }
-                else if (coeff[k] <= -ballK[k])
-                {
-                    coeff[k] = -ballK[k];
-                }
-            }
-            
-            #ifdef _OGD_IMPUTE_VERBOSE
-            predict_i = 0.0;
-            for (uint64_t k = 0; k < p; ++k)
-            {
-                predict_i += X.at(i - k - 1, j) * coeff[k];
-            }
-            diff = (X.at(i, j) - predict_i);
-            std::cout << "new coeff_estim-d"; new_coeff.t().print();
-            std::cout << "new coeff_learned"; coeff.t().print();
-            std::cout << "[post] predicted=" << predict_i << "; real=" << X.at(i, j) << "; diff=" << diff << std::endl << std::endl;
-            //usleep(1000 * 1000);
-            #endif
         }
     }
     
@@ -137,10 +117,75 @@ void OGDImpute::OGDImpute_call(arma::mat &X, uint64_t j)
     #ifdef _OGD_IMPUTE_VERBOSE
     std::cout << "noise_std = " << sqrt(noisestd) << std::endl;
     #endif
+}
+
+//
+// OGDStreamingImputer
+//
+
+OGDStreamingImputer::OGDStreamingImputer(uint64_t p)
+        : p(p),
+          ballK(std::vector<double>(p))
+{
+    if (p == 0)
+    {
+        throw std::runtime_error("OGDImpute needs an AR order of at least 1");
+    }
+    
+    const double inverseroot2 = 1 / sqrt(2.0);
     
-    for (uint64_t i = 0; i < X.n_rows; ++i)
+    for (uint64_t i = 0; i < p; ++i)
+    {
+        ballK[i] = std::pow(inverseroot2, i + 1);
+    }
+}
+
+void OGDStreamingImputer::warmUp(arma::mat &history)
+{
+    coeff = arma::zeros<arma::mat>(p, history.n_cols);
+    recent = arma::zeros<arma::mat>(p, history.n_cols);
+    t = 0;
+    
+    // the model learns online anyway, the history goes through the same steps as the stream
+    arma::vec row(history.n_cols);
+    
+    for (uint64_t i = 0; i < history.n_rows; ++i)
+    {
+        for (uint64_t j = 0; j < history.n_cols; ++j)
+        {
+            row[j] = history.at(i, j);
+        }
+        
+        pushRow(row);
+        
+        for (uint64_t j = 0; j < history.n_cols; ++j)
+        {
+            history.at(i, j) = row[j];
+        }
+    }
+}
+
+void OGDStreamingImputer::pushRow(arma::vec &row)
+{
+    for (uint64_t j = 0; j < row.n_elem; ++j)
     {
-        //matrix.at(i, j) -= 1.5;
+        if (t >= p)
+        {
+            OGDImpute::step(recent.colptr(j), row[j], coeff.colptr(j), ballK, t);
+        }
+        else if (std::isnan(row[j])) // the first p rows, there's no model yet
+        {
+            row[j] = 0.0;
+        }
+        
+        for (uint64_t k = 1; k < p; ++k)
+        {
+            recent.at(k - 1, j) = recent.at(k, j);
+        }
+        recent.at(p - 1, j) = row[j];
     }
+    
+    ++t;
 }
+
 } // namespace Algorithms
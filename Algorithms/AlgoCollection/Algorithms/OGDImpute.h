@@ -6,6 +6,8 @@
 
 #include <armadillo>
 
+#include "StreamingImputer.h"
+
 namespace Algorithms
 {
 
@@ -20,17 +22,40 @@ class OGDImpute
     
     std::vector<double> ballK;
     uint64_t lastIdx;
-    
+  
   public:
     explicit OGDImpute(arma::mat &_X, uint64_t _p);
     
     void ARPredict();
+    
+    // One step of the online AR(p) at time t >= p: past holds the last p values of the series, oldest first, coeff -
+    // the p coefficients. A missing value is predicted, an observed one retrains the coefficients; returns the
+    // prediction error of an observed value.
+    static double step(const double *past, double &value, double *coeff, const std::vector<double> &ballK,
+                       uint64_t t);
   
   private:
-    arma::vec coeff_lmse_retrain(uint64_t j, uint64_t i);
-    
     void OGDImpute_call(arma::mat &X, uint64_t j);
+
+};
+
+// The online AR(p) of OGDImpute_call, one model per column, with the coefficients kept between rows; every value goes
+// through OGDImpute::step.
+class OGDStreamingImputer : public StreamingImputer
+{
+  private:
+    uint64_t p;
+    std::vector<double> ballK;
+    arma::mat coeff; // p x m
+    arma::mat recent; // last p rows, oldest first
+    uint64_t t = 0; // rows seen
+  
+  public:
+    explicit OGDStreamingImputer(uint64_t p);
+    
+    void warmUp(arma::mat &history) override;
     
+    void pushRow(arma::vec &row) override;
 };
 
 } // namespace Algorithms
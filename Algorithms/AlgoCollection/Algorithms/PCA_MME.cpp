@@ -122,6 +122,43 @@ void Algorithms::PCA_MME::streamPCA_MME()
     doPCA_MME();
 }
 
+void PCA_MME::pushSample(arma::vec &sample)
+{
+    arma::vec filled = sample;
+    bool incomplete = false;
+    
+    for (uint64_t i = 0; i < filled.n_elem; ++i)
+    {
+        if (std::isnan(filled[i]))
+        {
+            filled[i] = 0.0;
+            incomplete = true;
+        }
+    }
+    
+    if (incomplete)
+    {
+        // same least squares as in the recovery step of doPCA_MME
+        arma::vec recon = Q * arma::solve(Q, filled);
+        
+        for (uint64_t i = 0; i < sample.n_elem; ++i)
+        {
+            if (std::isnan(sample[i]))
+            {
+                sample[i] = recon[i];
+            }
+        }
+    }
+    
+    _update(filled);
+    
+    if (++pushed == B)
+    {
+        _orthonormalize();
+        pushed = 0;
+    }
+}
+
 void PCA_MME::_update(const arma::vec &sample)
 {
     arma::mat sampleTQ = sample.t() * Q;
@@ -164,4 +201,25 @@ arma::vec PCA_MME::_getNextSample()
     return sample;
 }
 
+//
+// PCAMMEStreamingImputer
+//
+
+PCAMMEStreamingImputer::PCAMMEStreamingImputer(uint64_t k)
+        : k(k)
+{ }
+
+void PCAMMEStreamingImputer::warmUp(arma::mat &history)
+{
+    input = history.t();
+    pcamme.reset(new PCA_MME(input, k, true));
+    pcamme->doPCA_MME();
+    history = input.t();
+}
+
+void PCAMMEStreamingImputer::pushRow(arma::vec &row)
+{
+    pcamme->pushSample(row);
+}
+
 } // namespace Algorithms
@@ -4,8 +4,11 @@
 
 #pragma once
 
+#include <memory>
 #include <armadillo>
 
+#include "StreamingImputer.h"
+
 namespace Algorithms
 {
 
@@ -31,6 +34,8 @@ class PCA_MME
     uint64_t nextBlock;
     arma::mat Q;
     arma::mat Qnew;
+    
+    uint64_t pushed = 0; // samples taken by pushSample into the current block
   
   public:
     explicit PCA_MME(arma::mat &_input, uint64_t _k, bool singleBlock);
@@ -38,6 +43,10 @@ class PCA_MME
   public:
     void doPCA_MME();
     void streamPCA_MME();
+    
+    // a sample which isn't in the input: its missing values are imputed from Q, then it's accumulated into the next
+    // block, Q moves on when B of them are in
+    void pushSample(arma::vec &sample);
   
   private:
     void _update(const arma::vec &sample);
@@ -45,6 +54,22 @@ class PCA_MME
     arma::vec _getNextSample();
 };
 
+// PCA-MME on the (transposed) history, then every row is a new sample
+class PCAMMEStreamingImputer : public StreamingImputer
+{
+  private:
+    uint64_t k;
+    arma::mat input; // history, series are rows
+    std::unique_ptr<PCA_MME> pcamme; // refers to input
+  
+  public:
+    explicit PCAMMEStreamingImputer(uint64_t k);
+    
+    void warmUp(arma::mat &history) override;
+    
+    void pushRow(arma::vec &row) override;
+};
+
 } // namespace Algorithms
 
 
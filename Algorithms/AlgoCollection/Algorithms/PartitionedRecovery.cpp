@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <map>
+#include <numeric>
+
+#include "PartitionedRecovery.h"
+#include "CDMissingValueRecovery.h"
+#include "../Stats/Correlation.h"
+
+namespace Algorithms
+{
+
+constexpr uint64_t PartitionedRecovery::none;
+
+//
+// PartitionedRecovery constructors & desctructors
+//
+
+PartitionedRecovery::PartitionedRecovery(arma::mat &src)
+        : matrix(src)
+{ }
+
+//
+// PartitionedRecovery API
+//
+
+void PartitionedRecovery::partition()
+{
+    uint64_t m = matrix.n_cols;
+    arma::mat corr = correlation();
+    
+    std::vector<bool> incomplete(m, false);
+    
+    for (uint64_t j = 0; j < m; ++j)
+    {
+        const double *col = matrix.colptr(j);
+        incomplete[j] = std::any_of(col, col + matrix.n_rows, [](double x) { return std::isnan(x); });
+    }
+    
+    clusters.clear();
+    owners.assign(m, none);
+    
+    if (references > 0)
+    {
+        partitionByReferences(corr, incomplete);
+        return;
+    }
+    
+    for (uint64_t j = 0; j < m; ++j)
+    {
+        if (!incomplete[j] || owners[j] != none)
+        {
+            continue;
+        }
+        
+        uint64_t c = clusters.size();
+        
+        // j and the columns which are the most correlated with it, in either direction
+        std::vector<uint64_t> partners(m);
+        std::iota(partners.begin(), partners.end(), 0);
+        partners.erase(partners.begin() + (int64_t)j);
+        
+        std::stable_sort(partners.begin(), partners.end(),
+                         [&corr, j](uint64_t a, uint64_t b) { return std::fabs(corr.at(j, a)) > std::fabs(corr.at(j, b)); }
+        );
+        
+        partners.resize(std::min<uint64_t>(partners.size(), std::max<uint64_t>(clusterSize, 2) - 1));
+        
+        // incomplete partners that are close enough to j are recovered here as well, not in clusters of their own
+        for (uint64_t l : partners)
+        {
+            if (incomplete[l] && owners[l] == none && std::fabs(corr.at(j, l)) >= minCorrelation)
+            {
+                owners[l] = c;
+            }
+        }
+        
+        owners[j] = c;
+        partners.push_back(j);
+        std::sort(partners.begin(), partners.end());
+        clusters.emplace_back(std::move(partners));
+    }
+}
+
+void PartitionedRecovery::performRecovery()
+{
+    // missing cells may have been filled or added since the last call
+    partition();
+    
+    // clusters share columns, so nothing is written back until all of them are done
+    std::vector<arma::mat> recovered(clusters.size());
+    
+    #pragma omp parallel for num_threads(threads) schedule(dynamic) if(threads > 1)
+    for (uint64_t c = 0; c < clusters.size(); ++c)
+    {
+        recovered[c] = recoverCluster(c);
+    }
+    
+    for (uint64_t c = 0; c < clusters.size(); ++c)
+    {
+        for (uint64_t p = 0; p < clusters[c].size(); ++p)
+        {
+            uint64_t j = clusters[c][p];
+            
+            if (owners[j] != c)
+            {
+                continue;
+            }
+            
+            for (uint64_t i = 0; i < matrix.n_rows; ++i)
+            {
+                if (std::isnan(matrix.at(i, j)))
+                {
+                    matrix.at(i, j) = recovered[c].at(i, p);
+                }
+            }
+        }
+    }
+}
+
+//
+// PartitionedRecovery algorithm
+//
+
+// Correlation of the columns, missing cells are taken as the mean of the observed ones of their column.
+arma::mat PartitionedRecovery::correlation() const
+{
+    arma::mat filled(matrix);
+    
+    for (uint64_t j = 0; j < filled.n_cols; ++j)
+    {
+        double sum = 0.0;
+        uint64_t count = 0;
+        
+        for (uint64_t i = 0; i < filled.n_rows; ++i)
+        {
+            if (!std::isnan(filled.at(i, j)))
+            {
+                sum += filled.at(i, j);
+                ++count;
+            }
+        }
+        
+        double mean = count > 0 ? sum / (double)count : 0.0;
+        
+        for (uint64_t i = 0; i < filled.n_rows; ++i)
+        {
+            if (std::isnan(filled.at(i, j)))
+            {
+                filled.at(i, j) = mean;
+            }
+        }
+    }
+    
+    Stats::CorrelationMatrix cm(filled);
+    arma::mat corr = cm.getCorrelationMatrix();
+    
+    // constant columns
+    for (uint64_t i = 0; i < corr.n_elem; ++i)
+    {
+        if (std::isnan(corr[i]))
+        {
+            corr[i] = 0.0;
+        }
+    }
+    
+    return corr;
+}
+
+// The references of every incomplete column are the r complete columns most correlated with it (if there are less
+// than r complete columns, incomplete ones fill the rest). Columns with the same references share a cluster, so the
+// cost of a cluster is O(n * (r + sharing columns)) however wide the matrix is.
+void PartitionedRecovery::partitionByReferences(const arma::mat &corr, const std::vector<bool> &incomplete)
+{
+    uint64_t m = matrix.n_cols;
+    std::map<std::vector<uint64_t>, uint64_t> jobs;
+    
+    for (uint64_t j = 0; j < m; ++j)
+    {
+        if (!incomplete[j])
+        {
+            continue;
+        }
+        
+        std::vector<uint64_t> candidates(m);
+        std::iota(candidates.begin(), candidates.end(), 0);
+        candidates.erase(candidates.begin() + (int64_t)j);
+        
+        // complete columns first, each group by |corr| descending
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [&corr, &incomplete, j](uint64_t a, uint64_t b)
+                         {
+                             if (incomplete[a] != incomplete[b])
+                             {
+                                 return !incomplete[a];
+                             }
+                             
+                             return std::fabs(corr.at(j, a)) > std::fabs(corr.at(j, b));
+                         }
+        );
+        
+        candidates.resize(std::min<uint64_t>(candidates.size(), references));
+        std::sort(candidates.begin(), candidates.end());
+        
+        auto job = jobs.find(candidates);
+        
+        if (job == jobs.end())
+        {
+            job = jobs.emplace(candidates, clusters.size()).first;
+            clusters.emplace_back(std::move(candidates));
+        }
+        
+        std::vector<uint64_t> &cluster = clusters[job->second];
+        
+        // j may be a reference of the same job already (incomplete fill-in)
+        if (std::find(cluster.begin(), cluster.end(), j) == cluster.end())
+        {
+            cluster.insert(std::upper_bound(cluster.begin(), cluster.end(), j), j);
+        }
+        
+        owners[j] = job->second;
+    }
+}
+
+arma::mat PartitionedRecovery::recoverCluster(uint64_t c) const
+{
+    const std::vector<uint64_t> &columns = clusters[c];
+    arma::mat sub(matrix.n_rows, columns.size());
+    
+    for (uint64_t p = 0; p < columns.size(); ++p)
+    {
+        sub.col(p) = matrix.col(columns[p]);
+    }
+    
+    CDMissingValueRecovery rmv(sub);
+    rmv.setReduction(std::max<uint64_t>(1, std::min<uint64_t>(k, columns.size() - 1)));
+    rmv.policy = policy;
+    rmv.acceleration = acceleration;
+    
+    rmv.autoDetectMissingBlocks();
+    rmv.performRecovery();
+    
+    return sub;
+}
+
+} // namespace Algorithms
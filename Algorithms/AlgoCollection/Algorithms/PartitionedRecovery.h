@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <armadillo>
+
+#include "SignVectorPolicy.h"
+
+namespace Algorithms
+{
+
+// ORBITS over groups of correlated columns instead of the whole matrix. Every incomplete column is recovered inside
+// of a cluster made of it and its most correlated columns (clusters may overlap, complete columns only ever serve as
+// references), each cluster is an independent CDMissingValueRecovery and clusters are recovered in parallel.
+// With references > 0, the cluster of an incomplete column is its top-r correlated complete columns instead, and
+// incomplete columns that end up with the same references are recovered together.
+class PartitionedRecovery
+{
+    //
+    // Data
+    //
+  private:
+    arma::mat &matrix;
+  
+  public:
+    uint64_t k = 3;
+    uint64_t clusterSize = 10; // columns, the incomplete ones included; at least 2
+    double minCorrelation = 0.5; // |corr| for an incomplete column to be recovered in another one's cluster
+    uint64_t references = 0; // > 0 - reference selection, complete columns per incomplete one
+    uint64_t threads = 1; // clusters recovered at once
+    
+    // passed to the recovery of every cluster
+    SignVectorPolicy policy;
+    uint64_t acceleration = 0;
+    
+    std::vector<std::vector<uint64_t>> clusters;
+    std::vector<uint64_t> owners; // per column, the cluster its missing cells are taken from (none - complete column)
+    
+    //
+    // Constructors & destructors
+    //
+  public:
+    explicit PartitionedRecovery(arma::mat &src);
+    
+    //
+    // API
+    //
+  public:
+    void partition();
+    
+    // partitions the matrix as it is now, the clusters of an earlier call are not reused
+    void performRecovery();
+    
+    //
+    // Algorithm
+    //
+  private:
+    arma::mat correlation() const;
+    
+    void partitionByReferences(const arma::mat &corr, const std::vector<bool> &incomplete);
+    
+    arma::mat recoverCluster(uint64_t c) const;
+    
+    //
+    // Static
+    //
+  public:
+    static constexpr uint64_t none = static_cast<uint64_t>(-1);
+};
+
+} // namespace Algorithms
@@ -5,7 +5,6 @@
 #include <iostream>
 
 #include <cmath>
-#include <numeric>
 #include <algorithm>
 
 #include <chrono>
@@ -21,18 +20,16 @@ int64_t SPIRIT::doSpirit(arma::mat &A, uint64_t k0, uint64_t w, double lambda, b
     
     //
     // Step 0: prep
-    // impute last exising value instead of all NaNs
+    // find the missing block in column 0, all of it is forecast
     //
     
     uint64_t blockStart = static_cast<unsigned>(-1);
     uint64_t blockEnd = static_cast<unsigned>(-1);
-    double lastVal = 0;
     
     for (uint64_t i = 0; i < A.n_rows; ++i)
     {
         if (std::isnan(A.at(i,0)))
         {
-            lastVal = A.at(i - 1, 0);
             blockStart = i;
             break;
         }
@@ -40,7 +37,7 @@ int64_t SPIRIT::doSpirit(arma::mat &A, uint64_t k0, uint64_t w, double lambda, b
     
     uint64_t cutoff10 = A.n_rows - (A.n_rows / 10);
     blockStart = std::min(blockStart, cutoff10);
-
+    
     for (uint64_t i = A.n_rows - 1; i >= blockStart; --i)
     {
         if (std::isnan(A.at(i,0)))
@@ -49,159 +46,42 @@ int64_t SPIRIT::doSpirit(arma::mat &A, uint64_t k0, uint64_t w, double lambda, b
             break;
         }
     }
-
+    
     if (blockEnd == static_cast<unsigned>(-1))
     {
         blockEnd = A.n_rows - 1;
     }
-
-    for (uint64_t i = blockStart; i <= blockEnd; ++i)
-    {
-        A.at(i, 0) = lastVal;
-    }
     
-    uint64_t n = A.n_cols;
-    uint64_t totalTime = A.n_rows;
+    // the rows go through the same steps as in the streaming imputer
+    SPIRITStreamingImputer spirit(k0, w, lambda);
+    spirit.reset(A.n_cols);
     
-    arma::mat Proj(totalTime, n);
-    arma::mat recon(totalTime, n);
-    
-    //initialize w_i to unit vectors
-    arma::mat W = arma::eye<arma::mat>(n, n);
-    arma::vec d(n);
-    d.fill(0.01);
-    //k0 = number of eigencomponents, passed as a param
+    arma::vec row(A.n_cols);
     
-    arma::vec relErrors(totalTime);
-    
-    arma::mat prevW(W);
-    arma::mat Yvalues(totalTime, k0);
-    arma::mat ARc = arma::zeros<arma::mat>(w, k0); //AR coefficients, one for each hidden variable
-    std::vector<arma::mat> G;  //"Gain-Matrix", one for each hidden variable
-    
-    //initialize the "Gain-Matrix" with the identity matrix
-    for (uint64_t j = 0; j < k0; ++j)
-    {
-        G.emplace_back(arma::zeros<arma::mat>(w, w));
-        arma::mat &Gj = G[j];
-        arma::diagview<double> diag = Gj.diag();
-        diag.fill(1 / 0.004);
-    }
-    
-    for (uint64_t t = 0; t < totalTime; ++t)
+    for (uint64_t t = 0; t < A.n_rows; ++t)
     {
         if (stream && blockStart == t)
         {
             begin = std::chrono::steady_clock::now();
         }
-        //Simulate a missing block
-        if (blockStart <= t && t <= blockEnd)
-        {
-            //one-step forecast for each y-value
-            arma::vec Y(k0);
-            for (uint64_t j = 0; j < k0; ++j)
-            {
-                arma::vec xj = Yvalues.col(j).subvec(t - w, t - 1);
-                arma::vec aj = ARc.col(j);
-                Y[j] = arma::dot(xj, aj); //Eq 1 in Muscles paper
-            }
-            
-            //estimate the missing value
-            arma::vec xProj = prevW.submat(0, 0, prevW.n_rows - 1, k0 - 1) * Y; //reconstruction of the current time
-            A.at(t, 0) = xProj[0]; //feed back imputed value
-        }
-        
-        //update W for each y_t
-        arma::vec x = A.row(t).t();
-        arma::mat subW = W.submat(0, 0, W.n_rows - 1, k0 - 1);
         
-        for (uint64_t j = 0; j < k0; ++j)
+        for (uint64_t j = 0; j < A.n_cols; ++j)
         {
-            arma::vec Wj = subW.col(j);
-            updateW(x, Wj, d[j], lambda);
-            for (uint64_t i = 0; i < subW.n_rows; ++i)
-            {
-                subW(i, j) = Wj[i];
-            }
-        }
-        
-        grams(subW);
-        
-        for (uint64_t i = 0; i < subW.n_rows; ++i)
-        {
-            for (uint64_t j = 0; j < subW.n_cols; ++j)
-            {
-                W.at(i, j) = subW(i, j);
-            }
+            row[j] = A.at(t, j);
         }
         
-        //compute low-D projection, reconstruction and relative error
-        arma::vec Y = subW.t() * A.row(t).t(); //project to m-dimensional space
-        
-        prevW = arma::mat(W);
-        for (uint64_t i = 0; i < Y.n_rows; ++i)
-        {
-            Yvalues.at(t, i) = Y[i];
-        }
-    
-        arma::vec xActual = A.row(t).t(); //actual vector of the current time
-        arma::vec xProj = subW * Y; //reconstruction of the current time
-    
-        for (uint64_t i = 0; i < k0; ++i)
-        {
-            Proj.at(t, i) = Y[i];
-        }
-    
-        for (uint64_t i = 0; i < xProj.n_rows; ++i)
+        //Simulate a missing block
+        if (blockStart <= t && t <= blockEnd)
         {
-            recon.at(t, i) = xProj[i];
+            row[0] = NAN;
         }
         
-        arma::vec xOrth = xActual - xProj;
-        
-        // relErrors(t) = sum(xOrth.^2)/sum(xActual.^2);
-        relErrors[t] =
-                std::accumulate(xOrth.begin(), xOrth.end(), 0.0,
-                                [](const double &accu, const double &elem) { return accu + pow(elem, 2); })
-                /
-                std::accumulate(xActual.begin(), xActual.end(), 0.0,
-                                [](const double &accu, const double &elem) { return accu + pow(elem, 2); });
+        spirit.pushRow(row);
         
-        //update the AR coefficients for each hidden variable
-        if (t >= w)
+        for (uint64_t j = 0; j < A.n_cols; ++j)
         {
-            //we can start only when we have seen w measurements
-            for (uint64_t j = 0; j < k0; ++j)
-            {
-                arma::vec xj = Yvalues.col(j).subvec(t - w + 1, t);// xj = Yvalues(t - w + 1:t, j)^T;
-                double yj = Yvalues.at(t, j);
-                arma::vec aj = ARc.col(j);
-                arma::mat &Gj = G[j];
-    
-                arma::vec Gjxj = Gj * xj;
-                arma::vec GjxjT = Gj.t() * xj;
-    
-                arma::mat X = Gjxj * GjxjT.t();
-                
-                // Gj = (1/lambda)*Gj - (1/lambda) *inv(lambda + xj' * Gj * xj) * (Gj * xj) * (xj' * Gj);
-                Gj = (1 / lambda) * Gj - (1 / lambda) * (1 / (lambda + arma::dot(xj, Gjxj))) * X;
-                
-                Gjxj = Gj * xj; //recompute
-                aj -= Gjxj * (arma::dot(xj, aj) - yj);
-    
-                for (uint64_t i = 0; i < aj.n_rows; ++i)
-                {
-                    ARc.at(i, j) = aj[i];
-                }
-            }
+            A.at(t, j) = row[j];
         }
-        
-    }
-    
-    // pull data in col 0, rows [range] from recon into A
-    for (uint64_t i = blockStart; i <= blockEnd; ++i)
-    {
-        A.at(i, 0) = recon.at(i, 0);
     }
     
     return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
@@ -266,6 +146,165 @@ void SPIRIT::updateW(arma::vec &old_x, arma::vec &old_w, double &d, double lambd
     old_x = std::move(x);
 }
 
+//
+// SPIRITStreamingImputer
+//
+
+SPIRITStreamingImputer::SPIRITStreamingImputer(uint64_t k0, uint64_t w, double lambda)
+        : k0(k0), w(w), lambda(lambda)
+{ }
+
+arma::vec SPIRITStreamingImputer::recentSeries(uint64_t j) const
+{
+    arma::vec xj(w);
+    
+    for (uint64_t q = 0; q < w; ++q)
+    {
+        xj[q] = recent.at((head + q) % w, j);
+    }
+    
+    return xj;
+}
+
+void SPIRITStreamingImputer::reset(uint64_t n)
+{
+    W = arma::eye<arma::mat>(n, n);
+    d = arma::vec(n);
+    d.fill(0.01);
+    ARc = arma::zeros<arma::mat>(w, k0);
+    recent = arma::zeros<arma::mat>(w, k0);
+    last = arma::zeros<arma::vec>(n);
+    head = 0;
+    t = 0;
+    
+    G.clear();
+    for (uint64_t j = 0; j < k0; ++j)
+    {
+        G.emplace_back(arma::zeros<arma::mat>(w, w));
+        G[j].diag().fill(1 / 0.004);
+    }
+}
+
+void SPIRITStreamingImputer::warmUp(arma::mat &history)
+{
+    uint64_t n = history.n_cols;
+    reset(n);
+    
+    // SPIRIT is online anyway, the history goes through the same steps as the stream
+    arma::vec row(n);
+    
+    for (uint64_t i = 0; i < history.n_rows; ++i)
+    {
+        for (uint64_t j = 0; j < n; ++j)
+        {
+            row[j] = history.at(i, j);
+        }
+        
+        pushRow(row);
+        
+        for (uint64_t j = 0; j < n; ++j)
+        {
+            history.at(i, j) = row[j];
+        }
+    }
+}
+
+void SPIRITStreamingImputer::pushRow(arma::vec &row)
+{
+    std::vector<uint64_t> missing;
+    
+    for (uint64_t c = 0; c < row.n_elem; ++c)
+    {
+        if (std::isnan(row[c]))
+        {
+            missing.emplace_back(c);
+        }
+    }
+    
+    if (!missing.empty())
+    {
+        if (t >= w)
+        {
+            //one-step forecast for each y-value
+            arma::vec Y(k0);
+            for (uint64_t j = 0; j < k0; ++j)
+            {
+                Y[j] = arma::dot(recentSeries(j), ARc.col(j)); //Eq 1 in Muscles paper
+            }
+            
+            arma::vec xProj = W.cols(0, k0 - 1) * Y;
+            for (uint64_t c : missing)
+            {
+                row[c] = xProj[c];
+            }
+        }
+        else
+        {
+            // no forecast yet, the last value is carried forward
+            for (uint64_t c : missing)
+            {
+                row[c] = last[c];
+            }
+        }
+    }
+    
+    //update W for each y_t
+    arma::vec x = row;
+    arma::mat subW = W.cols(0, k0 - 1);
+    
+    for (uint64_t j = 0; j < k0; ++j)
+    {
+        arma::vec Wj = subW.col(j);
+        SPIRIT::updateW(x, Wj, d[j], lambda);
+        subW.col(j) = Wj;
+    }
+    
+    SPIRIT::grams(subW);
+    W.cols(0, k0 - 1) = subW;
+    
+    //project to m-dimensional space, reconstruct the missing cells from it
+    arma::vec Y = subW.t() * row;
+    
+    for (uint64_t j = 0; j < k0; ++j)
+    {
+        recent.at(head, j) = Y[j];
+    }
+    head = (head + 1) % w;
+    
+    arma::vec xProj = subW * Y;
+    for (uint64_t c : missing)
+    {
+        row[c] = xProj[c];
+    }
+    
+    //update the AR coefficients for each hidden variable, once w of them were seen
+    if (t >= w)
+    {
+        for (uint64_t j = 0; j < k0; ++j)
+        {
+            arma::vec xj = recentSeries(j);
+            double yj = Y[j];
+            arma::vec aj = ARc.col(j);
+            arma::mat &Gj = G[j];
+            
+            arma::vec Gjxj = Gj * xj;
+            arma::vec GjxjT = Gj.t() * xj;
+            
+            arma::mat X = Gjxj * GjxjT.t();
+            
+            Gj = (1 / lambda) * Gj - (1 / lambda) * (1 / (lambda + arma::dot(xj, Gjxj))) * X;
+            
+            Gjxj = Gj * xj; //recompute
+            aj -= Gjxj * (arma::dot(xj, aj) - yj);
+            
+            ARc.col(j) = aj;
+        }
+    }
+    
+    last = row;
+    ++t;
+}
+
 //*/
 
 } // namespace Algorithms
@@ -5,8 +5,11 @@
 #pragma once
 
 #include <tuple>
+#include <vector>
 #include <armadillo>
 
+#include "StreamingImputer.h"
+
 namespace Algorithms
 {
 
@@ -21,6 +24,41 @@ class SPIRIT
     static void updateW(arma::vec &old_x, arma::vec &old_w, double &d, double lambda);
     
     constexpr static double sqrtEps = 1.4901e-08; //taken from octave console
+    
+    friend class SPIRITStreamingImputer;
+};
+
+// The per-row step of SPIRIT, doSpirit runs its rows through it. The state (W, d, AR coefficients and their gain
+// matrices, last w hidden variables) is kept between rows; missing cells of any column are forecast by AR on the hidden
+// variables and replaced by their reconstruction once W took the row in.
+class SPIRITStreamingImputer : public StreamingImputer
+{
+  private:
+    uint64_t k0;
+    uint64_t w;
+    double lambda;
+    uint64_t t = 0;
+    
+    arma::mat W;
+    arma::vec d;
+    arma::mat ARc;
+    std::vector<arma::mat> G;
+    arma::mat recent; // ring of the last w rows of hidden variables
+    uint64_t head = 0; // the oldest one
+    arma::vec last;
+    
+    // hidden variable j over the last w rows, oldest first
+    arma::vec recentSeries(uint64_t j) const;
+  
+  public:
+    SPIRITStreamingImputer(uint64_t k0, uint64_t w, double lambda);
+    
+    // initial state for rows of n columns, nothing is seen yet
+    void reset(uint64_t n);
+    
+    void warmUp(arma::mat &history) override;
+    
+    void pushRow(arma::vec &row) override;
 };
 
 } // namespace Algorithms
@@ -0,0 +1,221 @@
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+
+#include "SignVectorPolicy.h"
+
+namespace Algorithms
+{
+
+//
+// SignVectorPolicy API
+//
+
+void SignVectorPolicy::restart()
+{
+    searched = false;
+    lastFlips = 0;
+    skips = 0;
+    lastDelta = std::numeric_limits<double>::infinity();
+    skippedSearches = 0;
+}
+
+SignVectorStep SignVectorPolicy::next(uint64_t iter, double delta)
+{
+    SignVectorStep step { true, false };
+    
+    switch (schedule)
+    {
+        case SignVectorSchedule::Cached:
+            break;
+        
+        case SignVectorSchedule::Fresh:
+            step.reset = true;
+            break;
+        
+        case SignVectorSchedule::SkipAfter:
+            step.search = iter <= count;
+            step.reset = fresh && step.search;
+            break;
+        
+        case SignVectorSchedule::SkipConverged:
+            step.search = delta > threshold;
+            step.reset = fresh && step.search;
+            break;
+        
+        case SignVectorSchedule::SearchAt:
+            step.search = listed(iter);
+            step.reset = fresh && step.search;
+            break;
+        
+        case SignVectorSchedule::Alternate:
+            step.search = iter <= count || iter % 2 == 1;
+            step.reset = fresh && step.search;
+            break;
+        
+        case SignVectorSchedule::ResetFirst:
+            step.reset = iter <= count;
+            break;
+        
+        case SignVectorSchedule::ResetUnconverged:
+            step.reset = delta > threshold;
+            break;
+        
+        case SignVectorSchedule::ResetEven:
+            step.reset = iter % 2 == 0;
+            break;
+        
+        case SignVectorSchedule::ResetAt:
+            step.reset = listed(iter);
+            break;
+        
+        case SignVectorSchedule::Adaptive:
+            // the last search left the sign vectors (almost) where they were, so as long as the iterations still make
+            // progress the decomposition can reuse them; the search is back once delta stalls or after maxSkips
+            step.search = iter == 1 || lastFlips > stableFlips || skips >= maxSkips || delta >= lastDelta;
+            lastDelta = delta;
+            break;
+    }
+    
+    searched = step.search;
+    
+    if (step.search)
+    {
+        skips = 0;
+    }
+    else
+    {
+        ++skips;
+        ++skippedSearches;
+    }
+    
+    return step;
+}
+
+void SignVectorPolicy::observe(uint64_t flips)
+{
+    if (searched)
+    {
+        lastFlips = flips;
+    }
+}
+
+//
+// SignVectorPolicy algorithm
+//
+
+bool SignVectorPolicy::listed(uint64_t iter) const
+{
+    for (uint64_t it : iterations)
+    {
+        if (it == iter)
+        {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+//
+// SignVectorPolicy static
+//
+
+static bool parseCount(const std::string &token, uint64_t &value)
+{
+    char *end = nullptr;
+    value = std::strtoull(token.c_str(), &end, 10);
+    return !token.empty() && *end == '\0';
+}
+
+static bool parseReal(const std::string &token, double &value)
+{
+    char *end = nullptr;
+    value = std::strtod(token.c_str(), &end);
+    return !token.empty() && *end == '\0';
+}
+
+bool SignVectorPolicy::parse(const std::string &name, SignVectorPolicy &policy)
+{
+    std::stringstream tokens(name);
+    std::string kind;
+    std::vector<std::string> params;
+    
+    std::getline(tokens, kind, ':');
+    
+    for (std::string token; std::getline(tokens, token, ':');)
+    {
+        params.push_back(token);
+    }
+    
+    policy = SignVectorPolicy();
+    
+    // skipping schedules come in two flavours, "-keep" searches from the previous sign vectors
+    const std::string keep = "-keep";
+    
+    if (kind.size() > keep.size() && kind.compare(kind.size() - keep.size(), keep.size(), keep) == 0)
+    {
+        kind.resize(kind.size() - keep.size());
+        policy.fresh = false;
+        
+        if (kind != "skip-after" && kind != "skip-converged" && kind != "search-at" && kind != "alternate")
+        {
+            return false;
+        }
+    }
+    
+    if (kind == "cached" || kind == "fresh" || kind == "reset-even")
+    {
+        policy.schedule = kind == "cached" ? SignVectorSchedule::Cached
+                        : kind == "fresh" ? SignVectorSchedule::Fresh
+                        : SignVectorSchedule::ResetEven;
+        return params.empty();
+    }
+    else if (kind == "skip-after" || kind == "reset-first")
+    {
+        policy.schedule = kind == "skip-after" ? SignVectorSchedule::SkipAfter : SignVectorSchedule::ResetFirst;
+        return params.size() == 1 && parseCount(params[0], policy.count);
+    }
+    else if (kind == "skip-converged" || kind == "reset-unconverged")
+    {
+        policy.schedule = kind == "skip-converged"
+                          ? SignVectorSchedule::SkipConverged
+                          : SignVectorSchedule::ResetUnconverged;
+        return params.empty() || (params.size() == 1 && parseReal(params[0], policy.threshold));
+    }
+    else if (kind == "search-at" || kind == "reset-at")
+    {
+        policy.schedule = kind == "search-at" ? SignVectorSchedule::SearchAt : SignVectorSchedule::ResetAt;
+        
+        for (const std::string &param : params)
+        {
+            uint64_t iter;
+            
+            if (!parseCount(param, iter))
+            {
+                return false;
+            }
+            
+            policy.iterations.push_back(iter);
+        }
+        
+        return !params.empty();
+    }
+    else if (kind == "alternate")
+    {
+        policy.schedule = SignVectorSchedule::Alternate;
+        policy.count = 3;
+        return params.empty() || (params.size() == 1 && parseCount(params[0], policy.count));
+    }
+    else if (kind == "adaptive")
+    {
+        policy.schedule = SignVectorSchedule::Adaptive;
+        return params.size() <= 2
+               && (params.size() < 1 || parseCount(params[0], policy.stableFlips))
+               && (params.size() < 2 || parseCount(params[1], policy.maxSkips));
+    }
+    
+    return false;
+}
+
+} // namespace Algorithms
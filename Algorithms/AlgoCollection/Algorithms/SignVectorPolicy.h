@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace Algorithms
+{
+
+// When the recovery repeats the sign vector search and when the search starts over from Z = 1
+enum class SignVectorSchedule
+{
+    Cached,           // search every iteration from the previous sign vectors
+    Fresh,            // search every iteration from Z = 1
+    SkipAfter,        // search on the first [count] iterations only
+    SkipConverged,    // search while delta > threshold
+    SearchAt,         // search on [iterations] only
+    Alternate,        // search on the first [count] iterations and on the odd ones past that
+    ResetFirst,       // search every iteration, from Z = 1 on the first [count] ones
+    ResetUnconverged, // search every iteration, from Z = 1 while delta > threshold
+    ResetEven,        // search every iteration, from Z = 1 on the even ones
+    ResetAt,          // search every iteration, from Z = 1 on [iterations]
+    Adaptive          // skip the search while the last one was stable and delta keeps going down
+};
+
+struct SignVectorStep
+{
+    bool search;
+    bool reset;
+};
+
+class SignVectorPolicy
+{
+    //
+    // Data
+    //
+  public:
+    SignVectorSchedule schedule = SignVectorSchedule::Cached;
+    uint64_t count = 0;
+    double threshold = 1E-2;
+    std::vector<uint64_t> iterations;
+    bool fresh = true; // skipping schedules: a search that does happen starts from Z = 1
+    
+    // Adaptive
+    uint64_t stableFlips = 0; // a search with at most that many flips didn't move the sign vectors
+    uint64_t maxSkips = 4; // consecutive iterations without a search
+    
+    uint64_t skippedSearches = 0; // over the last recovery
+    
+    //
+    // API
+    //
+  public:
+    // called when a recovery starts
+    void restart();
+    
+    // before the decomposition of iteration iter (1-based), delta is the one of the previous iteration
+    SignVectorStep next(uint64_t iter, double delta);
+    
+    // after it, flips made by the search (0 if it was skipped)
+    void observe(uint64_t flips);
+    
+    //
+    // Algorithm
+    //
+  private:
+    bool searched = false;
+    uint64_t lastFlips = 0;
+    uint64_t skips = 0;
+    double lastDelta = 0.0;
+    
+    bool listed(uint64_t iter) const;
+    
+    //
+    // Static
+    //
+  public:
+    // name[:param[:param...]], e.g. "cached", "skip-after:3", "reset-at:1:4:7", "adaptive:0:4"; false if not valid
+    static bool parse(const std::string &name, SignVectorPolicy &policy);
+};
+
+} // namespace Algorithms
@@ -0,0 +1,26 @@
+#include "StreamingImputer.h"
+
+namespace Algorithms
+{
+
+void StreamingImputer::pushRows(arma::mat &rows)
+{
+    arma::vec row(rows.n_cols);
+    
+    for (uint64_t i = 0; i < rows.n_rows; ++i)
+    {
+        for (uint64_t j = 0; j < rows.n_cols; ++j)
+        {
+            row[j] = rows.at(i, j);
+        }
+        
+        pushRow(row);
+        
+        for (uint64_t j = 0; j < rows.n_cols; ++j)
+        {
+            rows.at(i, j) = row[j];
+        }
+    }
+}
+
+} // namespace Algorithms
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <armadillo>
+
+namespace Algorithms
+{
+
+// Common face of the algorithms that impute a stream: the state is primed on the history once, then rows arrive one
+// by one (or in batches), each of them is imputed before the next one is looked at. Rows are in the original
+// orientation (one value per series), missing values are NaN and are replaced in place.
+class StreamingImputer
+{
+  public:
+    virtual ~StreamingImputer() = default;
+    
+    // the history is recovered in place; once, before the first row
+    virtual void warmUp(arma::mat &history) = 0;
+    
+    virtual void pushRow(arma::vec &row) = 0;
+    
+    // rows of <rows> in order, as if they were pushed one by one
+    virtual void pushRows(arma::mat &rows);
+};
+
+} // namespace Algorithms
@@ -13,6 +13,8 @@
 #include <iostream>
 #include <limits>
 #include <chrono>
+#include <stdexcept>
+#include <string>
 
 #include "TKCM.h"
 
@@ -25,7 +27,10 @@ TKCM::TKCM(arma::mat &mx)
         : matrix(mx)
 { }
 
-void TKCM::actionTkcm(const arma::mat &ref_ts, arma::vec &ts, uint64_t &offset, const uint64_t &L)
+constexpr uint64_t TKCM::k;
+constexpr uint64_t TKCM::d;
+
+void TKCM::actionTkcm(const arma::mat &ref_ts, arma::vec &ts, uint64_t &offset, const uint64_t &L, uint64_t l)
 {
     uint64_t nr_patterns = L - 2 * l + 1;
     arma::vec M((k + 1) * (nr_patterns + 1));
@@ -139,7 +144,7 @@ int64_t TKCM::performRecovery(bool stream)
             {
                 begin = std::chrono::steady_clock::now();
             }
-            actionTkcm(ref_ts, ts, offset, L);
+            actionTkcm(ref_ts, ts, offset, L, l);
         }
     }
     
@@ -152,4 +157,103 @@ int64_t TKCM::performRecovery(bool stream)
     return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
 }
 
+//
+// TKCMStreamingImputer
+//
+
+// missing values of column j are interpolated linearly between their neighbours, the ends are carried from the
+// closest value; a column without any value is set to 0
+static void interpolateColumn(arma::mat &matrix, uint64_t j)
+{
+    uint64_t prev = matrix.n_rows; // last finite row, none yet
+    
+    for (uint64_t i = 0; i <= matrix.n_rows; ++i)
+    {
+        if (i < matrix.n_rows && std::isnan(matrix.at(i, j)))
+        {
+            continue;
+        }
+        
+        // rows (prev, i) are a gap
+        uint64_t first = prev == matrix.n_rows ? 0 : prev + 1;
+        
+        for (uint64_t g = first; g < i; ++g)
+        {
+            if (prev == matrix.n_rows)
+            {
+                matrix.at(g, j) = i == matrix.n_rows ? 0.0 : matrix.at(i, j);
+            }
+            else if (i == matrix.n_rows)
+            {
+                matrix.at(g, j) = matrix.at(prev, j);
+            }
+            else
+            {
+                double w = (double)(g - prev) / (double)(i - prev);
+                matrix.at(g, j) = (1.0 - w) * matrix.at(prev, j) + w * matrix.at(i, j);
+            }
+        }
+        
+        prev = i;
+    }
+}
+
+void TKCMStreamingImputer::warmUp(arma::mat &history)
+{
+    L = history.n_rows;
+    l = L < 51 ? 20 : 30;
+    
+    if (history.n_cols < TKCM::d + 1 || L < 2 * l)
+    {
+        throw std::runtime_error("TKCM needs " + std::to_string(TKCM::d) + " reference columns and a history of at least "
+                                 + std::to_string(2 * l) + " rows");
+    }
+    
+    // the patterns are compared over the whole ring, there's no room for a missing value in it
+    for (uint64_t j = 0; j <= TKCM::d; ++j)
+    {
+        interpolateColumn(history, j);
+    }
+    
+    ts.zeros(L);
+    ref_ts.zeros(TKCM::d, L);
+    
+    for (uint64_t i = 0; i < L; ++i)
+    {
+        ts[i] = history.at(i, 0);
+        
+        for (uint64_t r = 0; r < TKCM::d; ++r)
+        {
+            ref_ts.at(r, i) = history.at(i, r + 1);
+        }
+    }
+    
+    offset = 0; // the slot of the oldest row, taken by the next one
+}
+
+void TKCMStreamingImputer::pushRow(arma::vec &row)
+{
+    const uint64_t previous = (offset + L - 1) % L;
+    
+    ts[offset] = row[0];
+    
+    for (uint64_t r = 0; r < TKCM::d; ++r)
+    {
+        if (std::isnan(row[r + 1])) // a missing reference value carries the previous one forward
+        {
+            row[r + 1] = ref_ts.at(r, previous);
+        }
+        
+        ref_ts.at(r, offset) = row[r + 1];
+    }
+    
+    if (std::isnan(row[0]))
+    {
+        TKCM::actionTkcm(ref_ts, ts, offset, L, l);
+        row[0] = ts[offset];
+    }
+    
+    offset = (offset + 1) % L;
+}
+
 } // namespace Algorithms
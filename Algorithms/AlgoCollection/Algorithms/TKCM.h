@@ -6,6 +6,8 @@
 
 #include <armadillo>
 
+#include "StreamingImputer.h"
+
 namespace Algorithms
 {
 
@@ -15,17 +17,37 @@ class TKCM
 {
   private:
     uint64_t l = 30;
-    const uint64_t k = 3;
-    const uint64_t d = 3;
     
     arma::mat &matrix;
-    
-    void actionTkcm(const arma::mat &ref_ts, arma::vec &ts, uint64_t &offset, const uint64_t &L);
   
   public:
     explicit TKCM(arma::mat &mx);
     
     int64_t performRecovery(bool stream = false);
+    
+    // ts[offset] := the average of the k values that follow the patterns most similar to the current one
+    static void actionTkcm(const arma::mat &ref_ts, arma::vec &ts, uint64_t &offset, const uint64_t &L, uint64_t l);
+    
+    static constexpr uint64_t k = 3;
+    static constexpr uint64_t d = 3; // reference series, columns 1..d
+};
+
+// Column 0 is imputed from the reference columns 1..d, over a ring of the last L rows, L being the history length.
+// Missing values of columns 0..d in the history are interpolated, missing reference values of a row carry the previous
+// row's ones forward.
+class TKCMStreamingImputer : public StreamingImputer
+{
+  private:
+    uint64_t L = 0;
+    uint64_t l = 30;
+    uint64_t offset = 0;
+    arma::vec ts;
+    arma::mat ref_ts;
+  
+  public:
+    void warmUp(arma::mat &history) override;
+    
+    void pushRow(arma::vec &row) override;
 };
 
 } // namespace Algorithms
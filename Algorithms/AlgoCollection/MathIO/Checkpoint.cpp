@@ -0,0 +1,208 @@
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Checkpoint.h"
+
+namespace MathIO
+{
+
+static const char signature[8] = { 'O', 'R', 'B', 'I', 'T', 'S', 'C', 'P' };
+
+constexpr uint64_t CheckpointReader::version;
+
+//
+// CheckpointWriter
+//
+
+CheckpointWriter::CheckpointWriter(const std::string &path)
+        : path(path), file(path + ".tmp", std::ios::binary | std::ios::trunc)
+{
+    write(signature, sizeof(signature));
+    write(CheckpointReader::version);
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    if (!committed)
+    {
+        file.close();
+        std::remove((path + ".tmp").c_str());
+    }
+}
+
+bool CheckpointWriter::isValid()
+{
+    return file.good();
+}
+
+bool CheckpointWriter::commit()
+{
+    file.close(); // flushes, the stream fails if the rest can't be written
+    
+    if (!file.good() || std::rename((path + ".tmp").c_str(), path.c_str()) != 0)
+    {
+        return false;
+    }
+    
+    committed = true;
+    return true;
+}
+
+void CheckpointWriter::write(uint64_t value)
+{
+    write(&value, sizeof(value));
+}
+
+void CheckpointWriter::write(double value)
+{
+    write(&value, sizeof(value));
+}
+
+void CheckpointWriter::write(const void *data, uint64_t bytes)
+{
+    file.write(static_cast<const char *>(data), static_cast<std::streamsize>(bytes));
+}
+
+void CheckpointWriter::write(const arma::mat &mx)
+{
+    write((uint64_t)mx.n_rows);
+    write((uint64_t)mx.n_cols);
+    write(mx.memptr(), mx.n_elem * sizeof(double));
+}
+
+void CheckpointWriter::write(const std::vector<uint64_t> &vector)
+{
+    write((uint64_t)vector.size());
+    write(vector.data(), vector.size() * sizeof(uint64_t));
+}
+
+void CheckpointWriter::write(const std::vector<double> &vector)
+{
+    write((uint64_t)vector.size());
+    write(vector.data(), vector.size() * sizeof(double));
+}
+
+//
+// CheckpointReader
+//
+
+CheckpointReader::CheckpointReader(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    
+    if (fd < 0)
+    {
+        return;
+    }
+    
+    struct stat info;
+    
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void *addr = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        
+        if (addr != MAP_FAILED)
+        {
+            map = static_cast<const char *>(addr);
+            size = static_cast<uint64_t>(info.st_size);
+        }
+    }
+    
+    close(fd); // the mapping stays valid
+}
+
+CheckpointReader::~CheckpointReader()
+{
+    if (map != nullptr)
+    {
+        munmap(const_cast<char *>(map), size);
+    }
+}
+
+bool CheckpointReader::isValid()
+{
+    if (map == nullptr || size < sizeof(signature) + sizeof(uint64_t)
+        || std::memcmp(map, signature, sizeof(signature)) != 0)
+    {
+        return false;
+    }
+    
+    pos = sizeof(signature);
+    return readWord() == version;
+}
+
+uint64_t CheckpointReader::readWord()
+{
+    uint64_t value;
+    read(&value, sizeof(value));
+    return value;
+}
+
+uint64_t CheckpointReader::readLength(uint64_t elementBytes, uint64_t perElement /*= 1*/)
+{
+    uint64_t length = readWord();
+    
+    if (length / perElement > (size - pos) / elementBytes)
+    {
+        throw std::runtime_error("checkpoint is truncated");
+    }
+    
+    return length;
+}
+
+double CheckpointReader::readDouble()
+{
+    double value;
+    read(&value, sizeof(value));
+    return value;
+}
+
+void CheckpointReader::read(void *data, uint64_t bytes)
+{
+    if (bytes == 0)
+    {
+        return;
+    }
+    
+    if (bytes > size - pos)
+    {
+        throw std::runtime_error("checkpoint is truncated");
+    }
+    
+    std::memcpy(data, map + pos, bytes);
+    pos += bytes;
+}
+
+void CheckpointReader::read(arma::mat &mx)
+{
+    uint64_t n = readWord();
+    uint64_t m = readWord();
+    
+    if (n != 0 && m > (size - pos) / sizeof(double) / n)
+    {
+        throw std::runtime_error("checkpoint is truncated");
+    }
+    
+    mx.set_size(n, m);
+    read(mx.memptr(), n * m * sizeof(double));
+}
+
+void CheckpointReader::read(std::vector<uint64_t> &vector)
+{
+    vector.resize(readLength(sizeof(uint64_t)));
+    read(vector.data(), vector.size() * sizeof(uint64_t));
+}
+
+void CheckpointReader::read(std::vector<double> &vector)
+{
+    vector.resize(readLength(sizeof(double)));
+    read(vector.data(), vector.size() * sizeof(double));
+}
+
+} // namespace MathIO
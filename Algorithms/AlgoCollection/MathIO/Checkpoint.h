@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+
+#include <vector>
+#include <armadillo>
+
+namespace MathIO
+{
+
+// Binary checkpoint: "ORBITSCP" and the format version, then the sections written by the saveState() functions one
+// after another. Everything is stored as 64-bit words in native byte order, so a checkpoint is read back on the
+// same architecture only.
+// The checkpoint is written next to the target (path + ".tmp") and only renamed over it by commit(), a save that
+// fails half-way leaves the previous checkpoint as it was.
+class CheckpointWriter
+{
+  private:
+    std::string path;
+    std::ofstream file;
+    bool committed = false;
+  
+  public:
+    explicit CheckpointWriter(const std::string &path);
+    
+    ~CheckpointWriter(); // the temporary file is removed unless it was committed
+    
+    CheckpointWriter(CheckpointWriter &other) = delete; // disable copying
+    CheckpointWriter(const CheckpointWriter &other) = delete;
+    
+    CheckpointWriter &operator=(CheckpointWriter &other) = delete;
+    
+    CheckpointWriter &operator=(const CheckpointWriter &other) = delete;
+    
+    bool isValid();
+    
+    // the temporary file is closed and renamed over the target; false - it couldn't be written or renamed
+    bool commit();
+    
+    void write(uint64_t value);
+    
+    void write(double value);
+    
+    void write(const void *data, uint64_t bytes);
+    
+    void write(const arma::mat &mx);
+    
+    void write(const std::vector<uint64_t> &vector);
+    
+    void write(const std::vector<double> &vector);
+};
+
+// The file is mapped into memory, reading is a copy out of the mapping.
+class CheckpointReader
+{
+  private:
+    const char *map = nullptr;
+    uint64_t size = 0;
+    uint64_t pos = 0;
+  
+  public:
+    explicit CheckpointReader(const std::string &path);
+    
+    ~CheckpointReader();
+    
+    CheckpointReader(CheckpointReader &other) = delete; // disable copying
+    CheckpointReader(const CheckpointReader &other) = delete;
+    
+    CheckpointReader &operator=(CheckpointReader &other) = delete;
+    
+    CheckpointReader &operator=(const CheckpointReader &other) = delete;
+    
+    // the file was mapped and has the right signature and version
+    bool isValid();
+    
+    uint64_t readWord();
+    
+    // a length word, checked against the rest of the file before anything is allocated for it: perElement elements
+    // take elementBytes together, a length they can't fit in is a truncated checkpoint
+    uint64_t readLength(uint64_t elementBytes, uint64_t perElement = 1);
+    
+    double readDouble();
+    
+    void read(void *data, uint64_t bytes);
+    
+    void read(arma::mat &mx);
+    
+    void read(std::vector<uint64_t> &vector);
+    
+    void read(std::vector<double> &vector);
+    
+    //
+    // Static
+    //
+  public:
+    static constexpr uint64_t version = 5;
+};
+
+} // namespace MathIO
@@ -15,6 +15,10 @@ void printUsage()
          << "    | arg:" << std::endl
          << "        | out, o      - the result of the recovery" << std::endl
          << "        | runtime, rt - runtime of the recovery" << std::endl
+         << "        | stream, s   - impute rows as they arrive: warm-up on the first n rows of the input," << std::endl
+         << "        |               then write every row recovered to stdout as soon as it's read" << std::endl
+         << "        |               [cd] -xtra takes the options of stream-window" << std::endl
+         << "        | server      - serve recovery requests on a Unix socket, see Performance/Server.h" << std::endl
          << "    | choose what to output from the action" << std::endl
          << std::endl
          << "-algorithm {str}, -alg {str}" << std::endl
@@ -22,13 +26,17 @@ void printUsage()
          << std::endl
          << "-input {str}, -in {str}" << std::endl
          << "    | file name, where to take the input matrix from" << std::endl
+         << "    | [stream] optional, - or none reads stdin" << std::endl
+         << "    | [server] path of the Unix socket to listen on" << std::endl
          << std::endl
          << "-output {str}, -out {str}" << std::endl
          << "    | file name, where to store the result of <test>" << std::endl
+         << "    | [stream] optional, latency of every streamed row in microseconds" << std::endl
          << std::endl
          << "[-n {int}] default(0)" << std::endl
          << "    | amount of rows to load from the input file" << std::endl
          << "    | 0 - load all of them" << std::endl
+         << "    | [stream] amount of rows to warm-up on, obligatory" << std::endl
          << std::endl
          << "[-m {int}] default(0)" << std::endl
          << "    | amount of columns to load from the input file" << std::endl
@@ -38,21 +46,48 @@ void printUsage()
          << "    | amount of columns of truncated decomposition to keep" << std::endl
          << "    | 0 (dec) - will be set to be equal to m" << std::endl
          << "    | 0 (rec) - will be automatically detected" << std::endl
+         << std::endl
+         << "[-threads {int}, -th {int}] default(1)" << std::endl
+         << "    | amount of threads for the decomposition [cd]" << std::endl
+         << "    | 1 - serial, results are identical for any amount > 1" << std::endl
          << "[-xtra {string}] default(\"\")" << std::endl
          << "    | extra string to be passed to the algorithm" << std::endl
+         << "    | stream     - recover the tail of the series as a stream" << std::endl
+         << "      drift=X - [stream, k = 0] the detected reduction is kept while no centroid moves by more (0.2, 0 - off)" << std::endl
+         << "    | stream-unified - same, through the common streaming interface: warm-up on the history, then row by row" << std::endl
+         << "    | stream-row - [cd] stream the tail row by row, bounded work per row" << std::endl
+         << "      checkpoint=FILE - [stream-row] restore the recovered history from FILE, or save it there if there's none" << std::endl
+         << "    | stream-window - [cd] same as stream-row, over a sliding window as long as the history" << std::endl
+         << "      foldin - [stream-row, stream-window] rows are imputed by least squares against the current decomposition" << std::endl
+         << "      refresh=N - [stream-row, stream-window] full decomposition every N streamed rows" << std::endl
+         << "      refresh-residual=X - [foldin] full decomposition after a row with a larger residual" << std::endl
+         << "      deadline=US - [stream-row, stream-window] rows that would take longer are estimated first, refined later" << std::endl
+         << "      normalize[=lock] - [stream-row, stream-window] z-score with running statistics, lock - fixed after the history" << std::endl
+         << "    | implicit   - [cd] don't copy the matrix for the decomposition, deflate it implicitly" << std::endl
+         << "    | anderson   - [cd] accelerate the recovery iterations with Anderson mixing" << std::endl
+         << "    | ssv=NAME   - [cd] sign vector search: lsv (default), lsv-noinit, issv, issv+" << std::endl
+         << "      gram-cache=BYTES - [issv, issv+] memory for columns of X * X^T kept across flips (64 MiB)" << std::endl
+         << "      max-sweeps=N, max-flips=N, search-time=US - [cd] budget of the sign vector search per decomposition" << std::endl
+         << "    | policy=NAME - [cd] when the iterations repeat the sign vector search:" << std::endl
+         << "    |     cached (default), fresh, adaptive[:flips[:skips]], skip-after:N, skip-converged[:eps]," << std::endl
+         << "    |     search-at:I[:I...], alternate[:N] (these four also as NAME-keep), reset-first:N," << std::endl
+         << "    |     reset-unconverged[:eps], reset-even, reset-at:I[:I...]" << std::endl
+         << "    | partition[=N] - [cd] recover groups of up to N (10) correlated columns separately, -threads at once" << std::endl
+         << "    | references=R - [cd] recover every incomplete column from its R most correlated complete ones" << std::endl
+         << "    | options of the plain [cd] recovery can be combined with a comma, e.g. implicit,anderson,policy=adaptive" << std::endl
          << std::endl;
 }
 
 enum class PTestType
 {
-    Output, Runtime, Undefined
+    Output, Runtime, Stream, Server, Undefined
 };
 
 int CommandLine2(
         int argc, char *argv[],
         PTestType &test, std::string &algoCode,
         std::string &input, std::string &output, std::string &xtra,
-        uint64_t &n, uint64_t &m, uint64_t &k
+        uint64_t &n, uint64_t &m, uint64_t &k, uint64_t &threads
 )
 {
     std::string temp;
@@ -85,6 +120,14 @@ int CommandLine2(
             {
                 test = PTestType::Runtime;
             }
+            else if (temp == "stream" || temp == "s")
+            {
+                test = PTestType::Stream;
+            }
+            else if (temp == "server")
+            {
+                test = PTestType::Server;
+            }
             else
             {
                 std::cout << "Unrecognized -test argument" << std::endl;
@@ -133,6 +176,22 @@ int CommandLine2(
             
             k = static_cast<uint64_t>(stoll(temp));
         }
+        else if (temp == "-threads" || temp == "-th")
+        {
+            ++i;
+            temp = argv[i];
+            
+            int64_t value = stoll(temp);
+            
+            if (value < 1)
+            {
+                std::cout << "-threads has to be at least 1" << std::endl;
+                printUsage();
+                return EXIT_FAILURE;
+            }
+            
+            threads = static_cast<uint64_t>(value);
+        }
         
         else if (temp == "-xtra")
         {
@@ -3,11 +3,14 @@
 //
 
 #include <iostream>
+#include <cctype>
+#include <cstdlib>
 #include <dirent.h>
 
 #include "MatrixReadWrite.h"
 #include "../Algebra/MissingBlock.hpp"
 #include "../Algebra/Auxiliary.h"
+#include "../Algebra/GrowingMatrix.h"
 
 using namespace std;
 
@@ -39,20 +42,17 @@ arma::mat MatrixReader::getFullMatrix()
 {
     setFirstRow();
     uint64_t m = rowContainer.size();
-    arma::mat mat(1, m);
+    Algebra::GrowingMatrix mat(m);
     
-    for (uint64_t j = 0; j < m; ++j)
-    {
-        mat(0, j) = rowContainer[j];
-    }
+    mat.appendRow(rowContainer);
     
     while (hasNextLine())
     {
         setNextRow();
-        Algebra::Operations::increment_matrix(mat, rowContainer);
+        mat.appendRow(rowContainer);
     }
     
-    return mat;
+    return mat.toMatrix();
 }
 
 arma::mat MatrixReader::getFixedMatrix(uint64_t n, uint64_t m)
@@ -103,7 +103,7 @@ arma::mat MatrixReader::getFixedRowMatrix(uint64_t n)
 
 arma::mat MatrixReader::getFixedColumnMatrix(uint64_t m)
 {
-    arma::mat mat(1, m);
+    Algebra::GrowingMatrix mat(m);
     
     rowContainer.reserve(m);
     for (uint64_t j = 0; j < m; ++j)
@@ -112,18 +112,15 @@ arma::mat MatrixReader::getFixedColumnMatrix(uint64_t m)
     }
     
     setNextRow(); // in fact first, but we know m, so it's a different call
-    for (uint64_t j = 0; j < m; ++j)
-    {
-        mat(0, j) = rowContainer[j];
-    }
+    mat.appendRow(rowContainer);
     
     while (hasNextLine())
     {
         setNextRow();
-        Algebra::Operations::increment_matrix(mat, rowContainer);
+        mat.appendRow(rowContainer);
     }
     
-    return mat;
+    return mat.toMatrix();
 }
 
 bool MatrixReader::hasNextLine()
@@ -138,6 +135,46 @@ arma::vec MatrixReader::readNextLine()
     return arma::vec(rowContainer);
 }
 
+bool MatrixReader::readNextRow(uint64_t m, arma::vec &row)
+{
+    getline(file, buffer);
+    rowContainer.clear();
+    
+    const char *pos = buffer.c_str();
+    
+    while (m == 0 || rowContainer.size() < m)
+    {
+        while (*pos == separator || std::isspace(static_cast<unsigned char>(*pos)))
+        {
+            ++pos;
+        }
+        
+        if (*pos == '\0')
+        {
+            break;
+        }
+        
+        char *end;
+        double value = std::strtod(pos, &end);
+        
+        if (end == pos || (*end != '\0' && *end != separator && !std::isspace(static_cast<unsigned char>(*end))))
+        {
+            return false;
+        }
+        
+        rowContainer.push_back(value);
+        pos = end;
+    }
+    
+    if (rowContainer.empty() || (m > 0 && rowContainer.size() < m))
+    {
+        return false;
+    }
+    
+    row = arma::vec(rowContainer);
+    return true;
+}
+
 void MatrixReader::setFirstRow()
 {
     getline(file, buffer);
@@ -236,4 +273,13 @@ void exportMatrix(std::string output, const arma::mat &mx)
     out_file.close();
 }
 
+void exportRow(std::ostream &out, const arma::vec &row)
+{
+    for (uint64_t j = 0; j < row.n_elem - 1; ++j)
+    {
+        out << row[j] << " ";
+    }
+    out << row[row.n_elem - 1] << std::endl;
+}
+
 } // namespace MathIO
@@ -47,6 +47,9 @@ class MatrixReader
 
     arma::vec readNextLine();
 
+    // the next line as its first m values (0 - all of them), false if it's blank, shorter or not a number
+    bool readNextRow(uint64_t m, arma::vec &row);
+
   private:
     void setFirstRow();
 
@@ -62,6 +65,9 @@ void exportDecompOutput(std::string &output, const arma::mat &Load, const arma::
 
 void exportMatrix(std::string output, const arma::mat &mx);
 
+// one line, in the same format as exportMatrix
+void exportRow(std::ostream &out, const arma::vec &row);
+
 /*
     TEMPLATE FUNCTIONS
 */
@@ -2,20 +2,30 @@
 // Created by Zakhar on 16/03/2017.
 //
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <tuple>
+#include <vector>
 
 #include "Benchmark.h"
 #include <cassert>
 #include "../Algebra/Auxiliary.h"
 
 #include "../Algorithms/CDMissingValueRecovery.h"
+#include "../Algorithms/PartitionedRecovery.h"
 #include "../Algorithms/TKCM.h"
 #include "../Algorithms/SPIRIT.h"
 #include "../Algorithms/GROUSE.h"
 #include "../Algorithms/OGDImpute.h"
 #include "../Algorithms/PCA_MME.h"
+#include "../Algorithms/StreamingImputer.h"
 
 using namespace Algorithms;
 
@@ -36,7 +46,215 @@ void verifyRecovery(arma::mat &mat)
     }
 }
 
-int64_t Recovery_CD(arma::mat &mat, uint64_t truncation)
+// xtra is a comma-separated list of options
+bool hasOption(const std::string &xtra, const std::string &option)
+{
+    std::stringstream options(xtra);
+    std::string token;
+    
+    while (std::getline(options, token, ','))
+    {
+        if (token == option)
+        {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+// value of a "name=value" option, empty if there is none
+std::string optionValue(const std::string &xtra, const std::string &name)
+{
+    std::stringstream options(xtra);
+    std::string token;
+    
+    while (std::getline(options, token, ','))
+    {
+        if (token.size() > name.size() && token.compare(0, name.size() + 1, name + "=") == 0)
+        {
+            return token.substr(name.size() + 1);
+        }
+    }
+    
+    return "";
+}
+
+// options with a count (rows, bytes, microseconds, ...) and with a real number as their value
+const std::vector<std::string> countOptions = {
+        "gram-cache", "max-sweeps", "max-flips", "search-time", "refresh", "deadline", "partition", "references"
+};
+const std::vector<std::string> realOptions = { "refresh-residual", "drift" };
+
+// the message for the first of those options which doesn't parse, empty if they all do
+std::string numberError(const std::string &xtra)
+{
+    for (const std::string &name : countOptions)
+    {
+        std::string value = optionValue(xtra, name);
+        
+        if (value.empty())
+        {
+            continue;
+        }
+        
+        char *end = nullptr;
+        errno = 0;
+        (void) std::strtoull(value.c_str(), &end, 10);
+        
+        if (!std::isdigit(static_cast<unsigned char>(value[0])) || *end != '\0' || errno == ERANGE)
+        {
+            return "Option '" + name + "=" + value + "' is not a valid count";
+        }
+    }
+    
+    for (const std::string &name : realOptions)
+    {
+        std::string value = optionValue(xtra, name);
+        
+        if (value.empty())
+        {
+            continue;
+        }
+        
+        char *end = nullptr;
+        errno = 0;
+        (void) std::strtod(value.c_str(), &end);
+        
+        if (end == value.c_str() || *end != '\0' || errno == ERANGE)
+        {
+            return "Option '" + name + "=" + value + "' is not a valid number";
+        }
+    }
+    
+    return "";
+}
+
+// value of a count option, fallback if there is none
+uint64_t countOption(const std::string &xtra, const std::string &name, uint64_t fallback)
+{
+    std::string value = optionValue(xtra, name);
+    std::string error = numberError(name + "=" + value);
+    
+    if (!error.empty())
+    {
+        std::cout << error << std::endl;
+        abort();
+    }
+    
+    return value.empty() ? fallback : std::strtoull(value.c_str(), nullptr, 10);
+}
+
+double realOption(const std::string &xtra, const std::string &name, double fallback)
+{
+    std::string value = optionValue(xtra, name);
+    std::string error = numberError(name + "=" + value);
+    
+    if (!error.empty())
+    {
+        std::cout << error << std::endl;
+        abort();
+    }
+    
+    return value.empty() ? fallback : std::strtod(value.c_str(), nullptr);
+}
+
+SignVectorPolicy policyOption(const std::string &xtra)
+{
+    SignVectorPolicy policy;
+    std::string name = optionValue(xtra, "policy");
+    
+    if (!name.empty() && !SignVectorPolicy::parse(name, policy))
+    {
+        std::cout << "Sign vector policy '" << name << "' is not valid" << std::endl;
+        abort();
+    }
+    
+    return policy;
+}
+
+// ssv=NAME[,gram-cache=BYTES][,max-sweeps=N][,max-flips=N][,search-time=US]
+void signVectorOptions(CDMissingValueRecovery &rmv, const std::string &xtra)
+{
+    std::string name = optionValue(xtra, "ssv");
+    
+    if (name == "issv")
+    {
+        rmv.passSignVectorStrategy(CDSignVectorStrategy_2::ISSVBase);
+    }
+    else if (name == "issv+")
+    {
+        rmv.passSignVectorStrategy(CDSignVectorStrategy_2::ISSVPlusBase);
+    }
+    else if (name == "lsv-noinit")
+    {
+        rmv.passSignVectorStrategy(CDSignVectorStrategy_2::LSVNoInit);
+    }
+    else if (!name.empty() && name != "lsv")
+    {
+        std::cout << "Sign vector search '" << name << "' is not valid" << std::endl;
+        abort();
+    }
+    
+    if (!optionValue(xtra, "gram-cache").empty())
+    {
+        rmv.passGramCache(countOption(xtra, "gram-cache", 0));
+    }
+    
+    rmv.setSearchBudget(countOption(xtra, "max-sweeps", 0), countOption(xtra, "max-flips", 0),
+                        countOption(xtra, "search-time", 0));
+}
+
+// foldin[,refresh=N][,refresh-residual=X][,deadline=US][,normalize[=lock]]
+void streamingOptions(CDMissingValueRecovery &rmv, const std::string &xtra)
+{
+    std::string normalization = optionValue(xtra, "normalize");
+    
+    if (!normalization.empty() && normalization != "lock")
+    {
+        std::cout << "Normalization '" << normalization << "' is not valid" << std::endl;
+        abort();
+    }
+    
+    rmv.foldIn = hasOption(xtra, "foldin");
+    rmv.persistentNormalization = hasOption(xtra, "normalize") || !normalization.empty();
+    rmv.refreshInterval = countOption(xtra, "refresh", 0);
+    rmv.refreshResidual = realOption(xtra, "refresh-residual", 0.0);
+    rmv.rowDeadline = countOption(xtra, "deadline", 0);
+    rmv.reductionDrift = realOption(xtra, "drift", rmv.reductionDrift);
+}
+
+void printStreamingMetrics(const CDMissingValueRecovery &rmv)
+{
+    if (rmv.rowDeadline > 0)
+    {
+        std::cout << "Deadline: " << rmv.rowDeadline << "us [fallbacks: " << rmv.metrics.fallbacks
+                  << "/" << rmv.metrics.rows << ", refined: " << rmv.metrics.refined
+                  << ", corrections: " << rmv.metrics.corrections << ", overruns: " << rmv.metrics.overruns << "]"
+                  << std::endl;
+    }
+}
+
+// First row of the stream: the first missing value in column 0, but at most 90% of the rows in (the last 10% are
+// streamed if column 0 is complete); the history keeps at least one row.
+uint64_t findStreamStart(const arma::mat &mat)
+{
+    uint64_t streamStart = mat.n_rows;
+    
+    for (uint64_t i = 0; i < mat.n_rows; ++i)
+    {
+        if (std::isnan(mat.at(i, 0)))
+        {
+            streamStart = i;
+            break;
+        }
+    }
+    
+    uint64_t cutoff10 = mat.n_rows - (mat.n_rows / 10);
+    return std::max<uint64_t>(std::min(streamStart, cutoff10), 1);
+}
+
+int64_t Recovery_CD(arma::mat &mat, uint64_t truncation, uint64_t threads, const std::string &xtra)
 {
     // Local
     int64_t result;
@@ -46,9 +264,15 @@ int64_t Recovery_CD(arma::mat &mat, uint64_t truncation)
     
     // Recovery
     rmv.setReduction(truncation);
+    rmv.setThreads(threads);
+    rmv.setImplicitDeflation(hasOption(xtra, "implicit"));
+    signVectorOptions(rmv, xtra);
+    rmv.acceleration = hasOption(xtra, "anderson") ? 5 : 0;
     rmv.disableCaching = false;
     rmv.useNormalization = false;
     
+    rmv.policy = policyOption(xtra);
+    
     begin = std::chrono::steady_clock::now();
     rmv.autoDetectMissingBlocks();
     rmv.performRecovery(truncation == mat.n_cols);
@@ -57,6 +281,44 @@ int64_t Recovery_CD(arma::mat &mat, uint64_t truncation)
     result = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
     std::cout << "Time (ORBITS): " << result << std::endl;
     
+    if (rmv.getTruncatedSearches() > 0)
+    {
+        std::cout << "Sign vector searches cut by the budget: " << rmv.getTruncatedSearches() << std::endl;
+    }
+    
+    verifyRecovery(mat);
+    return result;
+}
+
+int64_t Recovery_CD_Partitioned(arma::mat &mat, uint64_t truncation, uint64_t threads, const std::string &xtra)
+{
+    // Local
+    int64_t result;
+    PartitionedRecovery prv(mat);
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    
+    // Recovery
+    prv.k = truncation;
+    prv.threads = threads;
+    prv.clusterSize = countOption(xtra, "partition", prv.clusterSize);
+    prv.references = countOption(xtra, "references", 0);
+    prv.acceleration = hasOption(xtra, "anderson") ? 5 : 0;
+    prv.policy = policyOption(xtra);
+    
+    if (prv.clusterSize < 2)
+    {
+        std::cout << "Cluster size must be at least 2, a column isn't recovered on its own" << std::endl;
+        abort();
+    }
+    
+    begin = std::chrono::steady_clock::now();
+    prv.performRecovery();
+    end = std::chrono::steady_clock::now();
+    
+    result = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+    std::cout << "Time (ORBITS,partitioned): " << result << " [" << prv.clusters.size() << " clusters]" << std::endl;
+    
     verifyRecovery(mat);
     return result;
 }
@@ -182,21 +444,9 @@ int64_t Recovery_PCA_MME(arma::mat &mat, uint64_t truncation)
 
 // ================ streaming ==
 
-int64_t Recovery_CD_Streaming(arma::mat &mat, uint64_t truncation)
+int64_t Recovery_CD_Streaming(arma::mat &mat, uint64_t truncation, uint64_t threads, const std::string &xtra)
 {
-    uint64_t streamStart = 0;
-    
-    for (uint64_t i = 0; i < mat.n_rows; ++i)
-    {
-        if (std::isnan(mat.at(i, 0)))
-        {
-            streamStart = i;
-            break;
-        }
-    }
-    
-    uint64_t cutoff10 = mat.n_rows - (mat.n_rows / 10);
-    streamStart = std::min(streamStart, cutoff10);
+    uint64_t streamStart = findStreamStart(mat);
     
     arma::mat before_streaming = mat.submat(arma::span(0, streamStart - 1), arma::span::all);
     
@@ -208,8 +458,10 @@ int64_t Recovery_CD_Streaming(arma::mat &mat, uint64_t truncation)
     
     // Recovery
     rmv.setReduction(truncation);
+    rmv.setThreads(threads);
     rmv.disableCaching = false;
     rmv.useNormalization = false;
+    rmv.reductionDrift = realOption(xtra, "drift", rmv.reductionDrift); // k = 0: the second recovery may keep it
     
     rmv.autoDetectMissingBlocks();
     rmv.performRecovery(truncation == mat.n_cols);
@@ -225,7 +477,7 @@ int64_t Recovery_CD_Streaming(arma::mat &mat, uint64_t truncation)
     }
     
     begin = std::chrono::steady_clock::now();
-    rmv.autoDetectMissingBlocks();
+    rmv.autoDetectMissingBlocks(); // only the streamed rows are scanned
     rmv.performRecovery(truncation == mat.n_cols);
     end = std::chrono::steady_clock::now();
     
@@ -237,6 +489,159 @@ int64_t Recovery_CD_Streaming(arma::mat &mat, uint64_t truncation)
     return result;
 }
 
+int64_t Recovery_CD_RowStreaming(arma::mat &mat, uint64_t truncation, uint64_t threads, const std::string &xtra)
+{
+    uint64_t streamStart = findStreamStart(mat);
+    
+    arma::mat before_streaming = mat.submat(arma::span(0, streamStart - 1), arma::span::all);
+    
+    // Local
+    int64_t result = 0;
+    int64_t maxTick = 0;
+    CDMissingValueRecovery rmv(before_streaming);
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    
+    // Recovery
+    rmv.setReduction(truncation);
+    rmv.setThreads(threads);
+    rmv.disableCaching = false;
+    rmv.useNormalization = false;
+    rmv.issueCorrections = false; // the streamed rows stay in the matrix, refined cells are there already
+    streamingOptions(rmv, xtra);
+    
+    // checkpoint=FILE: the recovered history is restored from FILE if it's there, otherwise it's saved into it
+    std::string checkpoint = optionValue(xtra, "checkpoint");
+    
+    if (!checkpoint.empty() && rmv.loadCheckpoint(checkpoint))
+    {
+        if (before_streaming.n_rows != streamStart || before_streaming.n_cols != mat.n_cols)
+        {
+            throw std::runtime_error("Checkpoint '" + checkpoint + "' doesn't match the input matrix");
+        }
+    }
+    else
+    {
+        rmv.autoDetectMissingBlocks();
+        rmv.performRecovery(truncation == mat.n_cols);
+        
+        if (!checkpoint.empty() && !rmv.saveCheckpoint(checkpoint))
+        {
+            throw std::runtime_error("Checkpoint '" + checkpoint + "' can't be written");
+        }
+    }
+    
+    if (optionValue(xtra, "normalize") == "lock")
+    {
+        rmv.lockNormalization(); // the stream is scaled with the statistics of the history
+    }
+    
+    rmv.increment_raw(mat.n_rows - streamStart);
+    
+    // rows arrive one by one, each of them is imputed before the next one is revealed
+    for (uint64_t i = streamStart; i < mat.n_rows; ++i)
+    {
+        for (uint64_t j = 0; j < mat.n_cols; ++j)
+        {
+            before_streaming.at(i, j) = mat.at(i, j);
+        }
+        
+        begin = std::chrono::steady_clock::now();
+        rmv.performStreamingRecovery(1);
+        end = std::chrono::steady_clock::now();
+        
+        int64_t tick = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+        result += tick;
+        maxTick = std::max(maxTick, tick);
+    }
+    
+    // the stream is over, estimates that weren't refined yet are; corrections are in the matrix already
+    rmv.refinePending();
+    
+    std::cout << "Time (ORBITS,stream-row): " << result
+              << " [max tick: " << maxTick << ", refreshes: " << rmv.getRefreshes() << "]" << std::endl;
+    printStreamingMetrics(rmv);
+    
+    mat = std::move(before_streaming);
+    verifyRecovery(mat);
+    return result;
+}
+
+int64_t Recovery_CD_WindowStreaming(arma::mat &mat, uint64_t truncation, uint64_t threads, const std::string &xtra)
+{
+    uint64_t streamStart = findStreamStart(mat);
+    
+    // the window holds as many rows as the history, older rows are evicted as the stream goes on
+    arma::mat window = mat.submat(arma::span(0, streamStart - 1), arma::span::all);
+    
+    // Local
+    int64_t result = 0;
+    int64_t maxTick = 0;
+    CDMissingValueRecovery rmv(window);
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    
+    // Recovery
+    rmv.setReduction(truncation);
+    rmv.setThreads(threads);
+    rmv.disableCaching = false;
+    rmv.useNormalization = false;
+    streamingOptions(rmv, xtra);
+    
+    rmv.autoDetectMissingBlocks();
+    rmv.performRecovery(truncation == mat.n_cols);
+    
+    if (optionValue(xtra, "normalize") == "lock")
+    {
+        rmv.lockNormalization();
+    }
+    
+    mat.submat(arma::span(0, streamStart - 1), arma::span::all) = window;
+    rmv.setWindow(streamStart);
+    
+    std::vector<uint64_t> slotRows(streamStart); // stream row held by every slot of the window
+    
+    for (uint64_t s = 0; s < streamStart; ++s)
+    {
+        slotRows[s] = s;
+    }
+    
+    for (uint64_t i = streamStart; i < mat.n_rows; ++i)
+    {
+        arma::vec row = mat.row(i).t();
+        
+        begin = std::chrono::steady_clock::now();
+        uint64_t slot = rmv.pushRow(row);
+        end = std::chrono::steady_clock::now();
+        
+        mat.row(i) = window.row(slot);
+        slotRows[slot] = i;
+        
+        for (const CorrectionRecord &c : rmv.takeCorrections())
+        {
+            mat.at(slotRows[c.row], c.col) = c.value;
+        }
+        
+        int64_t tick = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+        result += tick;
+        maxTick = std::max(maxTick, tick);
+    }
+    
+    rmv.refinePending();
+    
+    for (const CorrectionRecord &c : rmv.takeCorrections())
+    {
+        mat.at(slotRows[c.row], c.col) = c.value;
+    }
+    
+    std::cout << "Time (ORBITS,stream-window): " << result
+              << " [max tick: " << maxTick << ", refreshes: " << rmv.getRefreshes() << "]" << std::endl;
+    printStreamingMetrics(rmv);
+    
+    verifyRecovery(mat);
+    return result;
+}
+
 int64_t Recovery_TKCM_Streaming(arma::mat &mat, uint64_t truncation)
 {
     (void) truncation;
@@ -271,19 +676,7 @@ int64_t Recovery_SPIRIT_Streaming(arma::mat &mat, uint64_t truncation)
 
 int64_t Recovery_OGDImpute_Streaming(arma::mat &mat, uint64_t truncation)
 {
-    uint64_t streamStart = 0;
-    
-    for (uint64_t i = 0; i < mat.n_rows; ++i)
-    {
-        if (std::isnan(mat.at(i, 0)))
-        {
-            streamStart = i;
-            break;
-        }
-    }
-    
-    uint64_t cutoff10 = mat.n_rows - (mat.n_rows / 10);
-    streamStart = std::min(streamStart, cutoff10);
+    uint64_t streamStart = findStreamStart(mat);
     
     arma::mat before_streaming = mat.submat(arma::span(0, streamStart - 1), arma::span::all);
     
@@ -319,19 +712,7 @@ int64_t Recovery_OGDImpute_Streaming(arma::mat &mat, uint64_t truncation)
 
 int64_t Recovery_SAGE_Streaming(arma::mat &mat, uint64_t truncation)
 {
-    uint64_t streamStart = 0;
-    
-    for (uint64_t i = 0; i < mat.n_rows; ++i)
-    {
-        if (std::isnan(mat.at(i, 0)))
-        {
-            streamStart = i;
-            break;
-        }
-    }// [!] despite transposing we search for the first index row-wise and later use it as column index
-    
-    uint64_t cutoff10 = mat.n_rows - (mat.n_rows / 10);
-    streamStart = std::min(streamStart, cutoff10);
+    uint64_t streamStart = findStreamStart(mat); // [!] despite transposing it's a row index, later used as a column one
     
     mat = mat.t();
     
@@ -375,19 +756,7 @@ int64_t Recovery_SAGE_Streaming(arma::mat &mat, uint64_t truncation)
 
 int64_t Recovery_PCA_MME_Streaming(arma::mat &mat, uint64_t truncation)
 {
-    uint64_t streamStart = 0;
-    
-    for (uint64_t i = 0; i < mat.n_rows; ++i)
-    {
-        if (std::isnan(mat.at(i, 0)))
-        {
-            streamStart = i;
-            break;
-        }
-    }// [!] despite transposing we search for the first index row-wise and later use it as column index
-    
-    uint64_t cutoff10 = mat.n_rows - (mat.n_rows / 10);
-    streamStart = std::min(streamStart, cutoff10);
+    uint64_t streamStart = findStreamStart(mat); // [!] despite transposing it's a row index, later used as a column one
     
     mat = mat.t();
     
@@ -426,14 +795,244 @@ int64_t Recovery_PCA_MME_Streaming(arma::mat &mat, uint64_t truncation)
     return result;
 }
 
+// Imputer of the unified streaming interface for the algorithm and the name it's reported under, or none.
+std::unique_ptr<StreamingImputer> createImputer(const std::string &algorithm, uint64_t truncation, uint64_t threads,
+                                                std::string &name)
+{
+    if (algorithm == "cd")
+    {
+        name = "ORBITS";
+        return std::unique_ptr<StreamingImputer>(new CDStreamingImputer(truncation, threads));
+    }
+    else if (algorithm == "tkcm")
+    {
+        name = "TKCM";
+        return std::unique_ptr<StreamingImputer>(new TKCMStreamingImputer());
+    }
+    else if (algorithm == "spirit")
+    {
+        name = "SPIRIT";
+        return std::unique_ptr<StreamingImputer>(new SPIRITStreamingImputer(truncation, 6, 1.0));
+    }
+    else if (algorithm == "ogdimpute")
+    {
+        name = "OGDImpute";
+        return std::unique_ptr<StreamingImputer>(new OGDStreamingImputer(truncation));
+    }
+    else if (algorithm == "grouse" || algorithm == "sage")
+    {
+        name = "SAGE";
+        return std::unique_ptr<StreamingImputer>(new SAGEStreamingImputer(truncation));
+    }
+    else if (algorithm == "pca-mme")
+    {
+        name = "PCA-MME";
+        return std::unique_ptr<StreamingImputer>(new PCAMMEStreamingImputer(truncation));
+    }
+    
+    return nullptr;
+}
+
+// The history (rows up to the first missing value in column 0, at most 90% of them) warms the imputer up, then the
+// rest of the rows are pushed one by one, each of them is timed.
+int64_t Recovery_Streaming(arma::mat &mat, StreamingImputer &imputer, const std::string &name)
+{
+    uint64_t streamStart = findStreamStart(mat);
+    
+    arma::mat history = mat.submat(arma::span(0, streamStart - 1), arma::span::all);
+    
+    // Local
+    int64_t result = 0;
+    int64_t maxTick = 0;
+    arma::vec row(mat.n_cols);
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    
+    // Recovery
+    imputer.warmUp(history);
+    mat.submat(arma::span(0, streamStart - 1), arma::span::all) = history;
+    
+    for (uint64_t i = streamStart; i < mat.n_rows; ++i)
+    {
+        for (uint64_t j = 0; j < mat.n_cols; ++j)
+        {
+            row[j] = mat.at(i, j);
+        }
+        
+        begin = std::chrono::steady_clock::now();
+        imputer.pushRow(row);
+        end = std::chrono::steady_clock::now();
+        
+        for (uint64_t j = 0; j < mat.n_cols; ++j)
+        {
+            mat.at(i, j) = row[j];
+        }
+        
+        int64_t tick = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+        result += tick;
+        maxTick = std::max(maxTick, tick);
+    }
+    
+    std::cout << "Time (" << name << ",stream-unified): " << result << " [max tick: " << maxTick << "]" << std::endl;
+    
+    verifyRecovery(mat);
+    return result;
+}
+
+int64_t RecoveryPipe(arma::mat &history, MathIO::MatrixReader &reader, std::ostream &out, std::ostream *latency,
+                     uint64_t truncation, const std::string &algorithm, const std::string &xtra, uint64_t threads)
+{
+    std::string name;
+    std::unique_ptr<StreamingImputer> imputer = createImputer(algorithm, truncation, threads, name);
+    
+    if (!imputer)
+    {
+        std::cout << "Algorithm name '" << algorithm << "' does not exist or is not valid option for streaming" << std::endl;
+        abort();
+    }
+    
+    // Local
+    int64_t result = 0;
+    int64_t maxTick = 0;
+    uint64_t rows = 0;
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    
+    // Recovery
+    CDStreamingImputer *cd = dynamic_cast<CDStreamingImputer *>(imputer.get());
+    
+    if (cd != nullptr)
+    {
+        CDMissingValueRecovery &rmv = cd->prepare(history);
+        rmv.policy = policyOption(xtra);
+        rmv.issueCorrections = false; // the rows are written already, refined cells only go into the window
+        streamingOptions(rmv, xtra);
+    }
+    
+    imputer->warmUp(history);
+    
+    if (cd != nullptr && optionValue(xtra, "normalize") == "lock")
+    {
+        cd->getRecovery().lockNormalization();
+    }
+    
+    for (uint64_t i = 0; i < history.n_rows; ++i)
+    {
+        MathIO::exportRow(out, history.row(i).t());
+    }
+    out.flush();
+    
+    arma::vec row;
+    
+    while (reader.hasNextLine()) // blocks until the next row arrives or the input is closed
+    {
+        if (!reader.readNextRow(history.n_cols, row))
+        {
+            std::cout << "Skipped a line that isn't a row of " << history.n_cols << " numbers" << std::endl;
+            continue;
+        }
+        
+        begin = std::chrono::steady_clock::now();
+        imputer->pushRow(row);
+        MathIO::exportRow(out, row);
+        out.flush();
+        end = std::chrono::steady_clock::now();
+        
+        int64_t tick = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+        result += tick;
+        maxTick = std::max(maxTick, tick);
+        ++rows;
+        
+        if (latency != nullptr)
+        {
+            *latency << tick << std::endl;
+        }
+    }
+    
+    std::cout << "Time (" << name << ",pipe): " << result
+              << " [rows: " << rows << ", max tick: " << maxTick << "]" << std::endl;
+    
+    return result;
+}
+
+std::string RecoveryError(const std::string &algorithm, const std::string &xtra)
+{
+    static const std::vector<std::string> algorithms = { "cd", "tkcm", "spirit", "grouse", "ogdimpute", "pca-mme" };
+    
+    bool rows = hasOption(xtra, "stream-row") || hasOption(xtra, "stream-window");
+    bool streaming = hasOption(xtra, "stream") || xtra == "stream-unified";
+    bool known = std::find(algorithms.begin(), algorithms.end(), algorithm) != algorithms.end();
+    
+    if (rows ? algorithm != "cd" : !known && !(streaming && algorithm == "sage"))
+    {
+        return "Algorithm name '" + algorithm + "' is not valid" + (rows ? " for row streaming" : "");
+    }
+    
+    if (algorithm != "cd" || xtra == "stream-unified")
+    {
+        return ""; // the other algorithms and the common streaming interface take no options
+    }
+    
+    std::string number = numberError(xtra);
+    
+    if (!number.empty() || streaming)
+    {
+        return number; // stream only takes drift=
+    }
+    
+    std::string normalization = optionValue(xtra, "normalize");
+    
+    if (rows)
+    {
+        return normalization.empty() || normalization == "lock"
+               ? "" : "Normalization '" + normalization + "' is not valid";
+    }
+    
+    SignVectorPolicy policy;
+    std::string name = optionValue(xtra, "policy");
+    
+    if (!name.empty() && !SignVectorPolicy::parse(name, policy))
+    {
+        return "Sign vector policy '" + name + "' is not valid";
+    }
+    
+    std::string size = optionValue(xtra, "partition");
+    
+    if (hasOption(xtra, "partition") || !size.empty() || !optionValue(xtra, "references").empty())
+    {
+        return size.empty() || std::strtoull(size.c_str(), nullptr, 10) >= 2
+               ? "" : "Cluster size must be at least 2, a column isn't recovered on its own";
+    }
+    
+    name = optionValue(xtra, "ssv");
+    
+    return name.empty() || name == "lsv" || name == "lsv-noinit" || name == "issv" || name == "issv+"
+           ? "" : "Sign vector search '" + name + "' is not valid";
+}
+
 int64_t Recovery(arma::mat &mat, uint64_t truncation,
-                 const std::string &algorithm, const std::string &xtra)
+                 const std::string &algorithm, const std::string &xtra, uint64_t threads)
 {
-    if (xtra == "stream")
+    if (hasOption(xtra, "stream-row") || hasOption(xtra, "stream-window"))
     {
         if (algorithm == "cd")
         {
-            return Recovery_CD_Streaming(mat, truncation);
+            return hasOption(xtra, "stream-row")
+                   ? Recovery_CD_RowStreaming(mat, truncation, threads, xtra)
+                   : Recovery_CD_WindowStreaming(mat, truncation, threads, xtra);
+        }
+        else
+        {
+            std::cout << "Algorithm name '" << algorithm << "' does not exist or is not valid option for row streaming" << std::endl;
+            abort();
+        }
+    }
+    
+    if (hasOption(xtra, "stream"))
+    {
+        if (algorithm == "cd")
+        {
+            return Recovery_CD_Streaming(mat, truncation, threads, xtra);
         }
         else if (algorithm == "tkcm")
         {
@@ -462,9 +1061,28 @@ int64_t Recovery(arma::mat &mat, uint64_t truncation,
         }
     }
     
+    if (xtra == "stream-unified")
+    {
+        std::string name;
+        std::unique_ptr<StreamingImputer> imputer = createImputer(algorithm, truncation, threads, name);
+        
+        if (!imputer)
+        {
+            std::cout << "Algorithm name '" << algorithm << "' does not exist or is not valid option for streaming" << std::endl;
+            abort();
+        }
+        
+        return Recovery_Streaming(mat, *imputer, name);
+    }
+    
     if (algorithm == "cd")
     {
-        return Recovery_CD(mat, truncation);
+        bool partitioned = hasOption(xtra, "partition") || !optionValue(xtra, "partition").empty()
+                           || !optionValue(xtra, "references").empty();
+        
+        return partitioned
+               ? Recovery_CD_Partitioned(mat, truncation, threads, xtra)
+               : Recovery_CD(mat, truncation, threads, xtra);
     }
     else if (algorithm == "tkcm")
     {
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <ostream>
 #include <armadillo>
 
 #include "../MathIO/MatrixReadWrite.h"
@@ -14,7 +15,22 @@ namespace Performance
 
 int64_t
 Recovery(arma::mat &mat, uint64_t truncation,
-         const std::string &algorithm, const std::string &xtra);
+         const std::string &algorithm, const std::string &xtra, uint64_t threads = 1);
+
+// The message Recovery() would abort with on <algorithm> and <xtra>, empty if it won't. A checkpoint that doesn't fit
+// the matrix throws from Recovery() instead.
+std::string
+RecoveryError(const std::string &algorithm, const std::string &xtra);
+
+// Pipe streaming: the imputer warms up on <history>, then every row of <reader> is imputed as soon as it's read.
+// All rows, the history included, are written recovered to <out> and flushed; the time every streamed row took
+// (imputation and writing, in microseconds) goes to <latency> if it's given. Returns the total of those.
+// A line that isn't a row of as many numbers as the history has columns is skipped with a message.
+// cd takes the options of stream-window from <xtra> (foldin, refresh=, deadline=, normalize, policy=, ...), a row
+// that misses its deadline is written with its estimate; the other algorithms take none.
+int64_t
+RecoveryPipe(arma::mat &history, MathIO::MatrixReader &reader, std::ostream &out, std::ostream *latency,
+             uint64_t truncation, const std::string &algorithm, const std::string &xtra, uint64_t threads = 1);
 
 
 } // namespace Performance
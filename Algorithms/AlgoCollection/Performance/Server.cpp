@@ -0,0 +1,333 @@
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Server.h"
+#include "Benchmark.h"
+
+namespace Performance
+{
+
+//
+// Socket I/O
+//
+
+static bool readLine(int fd, std::string &line)
+{
+    line.clear();
+    char c;
+    
+    while (read(fd, &c, 1) == 1) // requests are short, the recovery dominates
+    {
+        if (c == '\n')
+        {
+            return true;
+        }
+        line.push_back(c);
+    }
+    
+    return !line.empty();
+}
+
+static bool writeAll(int fd, const void *data, uint64_t bytes)
+{
+    const char *pos = static_cast<const char *>(data);
+    
+    while (bytes > 0)
+    {
+        ssize_t written = write(fd, pos, bytes);
+        
+        if (written <= 0)
+        {
+            return false;
+        }
+        
+        pos += written;
+        bytes -= static_cast<uint64_t>(written);
+    }
+    
+    return true;
+}
+
+static bool writeWord(int fd, uint64_t value)
+{
+    return writeAll(fd, &value, sizeof(value));
+}
+
+static void replyError(int fd, const std::string &message)
+{
+    std::cout << "[server] " << message << std::endl;
+    
+    (void) (writeWord(fd, 1) && writeWord(fd, message.size()) && writeAll(fd, message.data(), message.size()));
+}
+
+//
+// RecoveryServer
+//
+
+RecoveryServer::RecoveryServer(const std::string &socketPath, uint64_t threads)
+        : path(socketPath), threads(threads)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        std::cout << "Socket path is too long: " << path << std::endl;
+        return;
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    
+    // a socket left by a server that didn't exit cleanly, anything else isn't touched
+    struct stat info;
+    
+    if (stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+    {
+        unlink(path.c_str());
+    }
+    
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    
+    if (listener < 0
+        || bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+        || listen(listener, 1) != 0)
+    {
+        std::cout << "Can't listen on " << path << ": " << std::strerror(errno) << std::endl;
+        
+        if (listener >= 0)
+        {
+            close(listener);
+            listener = -1;
+        }
+    }
+}
+
+RecoveryServer::~RecoveryServer()
+{
+    if (listener >= 0)
+    {
+        close(listener);
+        unlink(path.c_str());
+    }
+}
+
+bool RecoveryServer::isValid()
+{
+    return listener >= 0;
+}
+
+void RecoveryServer::run()
+{
+    signal(SIGPIPE, SIG_IGN); // a client gone mid-reply only ends its connection
+    running = true;
+    
+    std::cout << "[server] listening on " << path << std::endl;
+    
+    while (running)
+    {
+        int fd = accept(listener, nullptr, nullptr);
+        
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cout << "[server] accept failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        
+        serve(fd);
+        close(fd);
+    }
+}
+
+void RecoveryServer::serve(int fd)
+{
+    std::string request;
+    
+    while (running && readLine(fd, request))
+    {
+        handle(fd, request);
+    }
+}
+
+void RecoveryServer::handle(int fd, const std::string &request)
+{
+    std::stringstream words(request);
+    std::string command;
+    words >> command;
+    
+    if (command == "load")
+    {
+        std::string name, file;
+        words >> name >> file;
+        
+        if (file.empty())
+        {
+            replyError(fd, "load needs NAME PATH");
+            return;
+        }
+        
+        load(fd, name, file);
+    }
+    else if (command == "recover")
+    {
+        std::string name, algorithm, blocks, xtra;
+        uint64_t k = 0, n = 0, m = 0;
+        words >> name >> algorithm >> k >> n >> m >> blocks;
+        
+        if (words.fail())
+        {
+            replyError(fd, "recover needs NAME ALG K N M BLOCKS [XTRA]");
+            return;
+        }
+        
+        words >> xtra;
+        recover(fd, name, algorithm, k, n, m, blocks, xtra);
+    }
+    else if (command == "unload")
+    {
+        std::string name;
+        words >> name;
+        
+        if (datasets.erase(name) == 0)
+        {
+            replyError(fd, "no dataset " + name);
+            return;
+        }
+        
+        (void) writeWord(fd, 0);
+    }
+    else if (command == "quit")
+    {
+        running = false;
+        (void) writeWord(fd, 0);
+    }
+    else
+    {
+        replyError(fd, "unknown request: " + command);
+    }
+}
+
+void RecoveryServer::load(int fd, const std::string &name, const std::string &file)
+{
+    std::string input = file;
+    MathIO::MatrixReader reader(input, ' ');
+    
+    if (!reader.isValid() || !reader.hasNextLine())
+    {
+        replyError(fd, "can't read " + file);
+        return;
+    }
+    
+    arma::mat parsed;
+    
+    try
+    {
+        parsed = reader.getFullMatrix();
+    }
+    catch (std::exception &e) // stod on a value that isn't a number
+    {
+        replyError(fd, "can't parse " + file + ": " + e.what());
+        return;
+    }
+    
+    arma::mat &matrix = datasets[name];
+    matrix = std::move(parsed);
+    
+    std::cout << "[server] " << name << ": " << matrix.n_rows << "x" << matrix.n_cols << " from " << file << std::endl;
+    
+    (void) (writeWord(fd, 0) && writeWord(fd, matrix.n_rows) && writeWord(fd, matrix.n_cols));
+}
+
+void RecoveryServer::recover(int fd, const std::string &name, const std::string &algorithm, uint64_t k,
+                             uint64_t n, uint64_t m, const std::string &blocks, const std::string &xtra)
+{
+    auto dataset = datasets.find(name);
+    
+    if (dataset == datasets.end())
+    {
+        replyError(fd, "no dataset " + name);
+        return;
+    }
+    
+    std::string error = RecoveryError(algorithm, xtra); // Recovery() would abort the server on it
+    
+    if (!error.empty())
+    {
+        replyError(fd, error);
+        return;
+    }
+    
+    arma::mat &source = dataset->second;
+    n = n == 0 ? source.n_rows : n;
+    m = m == 0 ? source.n_cols : m;
+    
+    if (n > source.n_rows || m > source.n_cols)
+    {
+        replyError(fd, "dataset " + name + " is smaller than requested");
+        return;
+    }
+    
+    if (k > m)
+    {
+        replyError(fd, "truncation factor k can't be larger than m");
+        return;
+    }
+    
+    arma::mat matrix = source.submat(0, 0, n - 1, m - 1);
+    
+    if (blocks != "-")
+    {
+        std::stringstream list(blocks);
+        std::string block;
+        
+        while (std::getline(list, block, ','))
+        {
+            uint64_t col = 0, start = 0, size = 0;
+            char sep1 = 0, sep2 = 0;
+            std::stringstream fields(block);
+            fields >> col >> sep1 >> start >> sep2 >> size;
+            
+            if (fields.fail() || sep1 != ':' || sep2 != ':' || col >= m || start > n || size > n - start)
+            {
+                replyError(fd, "invalid block " + block);
+                return;
+            }
+            
+            for (uint64_t i = start; i < start + size; ++i)
+            {
+                matrix.at(i, col) = NAN;
+            }
+        }
+    }
+    
+    int64_t runtime;
+    
+    try
+    {
+        runtime = Recovery(matrix, k == 0 ? m : k, algorithm, xtra, threads);
+    }
+    catch (std::exception &e)
+    {
+        replyError(fd, std::string("recovery failed: ") + e.what());
+        return;
+    }
+    
+    (void) (writeWord(fd, 0) && writeWord(fd, static_cast<uint64_t>(runtime))
+            && writeWord(fd, matrix.n_rows) && writeWord(fd, matrix.n_cols)
+            && writeAll(fd, matrix.memptr(), matrix.n_elem * sizeof(double)));
+}
+
+} // namespace Performance
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <armadillo>
+
+namespace Performance
+{
+
+// Recovery requests over a Unix domain socket, served one connection at a time. Datasets are parsed once and stay in
+// memory across requests and connections, every recovery runs on a copy of (a part of) one of them.
+//
+// A request is a line of space-separated words:
+//     load NAME PATH                        - reads the matrix in PATH (same format as -in) as the dataset NAME
+//     recover NAME ALG K N M BLOCKS [XTRA]  - same as -test o on the first N rows and M columns of NAME (0 - all),
+//                                             BLOCKS = col:start:size[,col:start:size...] are removed first, - none
+//     unload NAME
+//     quit                                  - stops the server
+// The reply is binary, 64-bit words in native byte order: the status (0 - ok) and
+//     error: length of the message, the message
+//     load: n, m of the dataset
+//     recover: runtime in microseconds, n, m, the recovered matrix column by column as doubles
+// A recovery the command line would abort on (an unknown algorithm or xtra option) is rejected before it starts.
+class RecoveryServer
+{
+    //
+    // Data
+    //
+  private:
+    std::string path;
+    int listener = -1;
+    uint64_t threads;
+    bool running = false;
+    
+    std::map<std::string, arma::mat> datasets;
+    
+    //
+    // Constructors & destructors
+    //
+  public:
+    RecoveryServer(const std::string &socketPath, uint64_t threads);
+    
+    ~RecoveryServer();
+    
+    RecoveryServer(RecoveryServer &other) = delete; // disable copying
+    RecoveryServer(const RecoveryServer &other) = delete;
+    
+    RecoveryServer &operator=(RecoveryServer &other) = delete;
+    
+    RecoveryServer &operator=(const RecoveryServer &other) = delete;
+    
+    //
+    // API
+    //
+  public:
+    // the socket is bound and listened on
+    bool isValid();
+    
+    // serves connections until a quit request
+    void run();
+    
+    //
+    // Algorithm
+    //
+  private:
+    void serve(int fd);
+    
+    void handle(int fd, const std::string &request);
+    
+    void load(int fd, const std::string &name, const std::string &file);
+    
+    void recover(int fd, const std::string &name, const std::string &algorithm, uint64_t k, uint64_t n, uint64_t m,
+                 const std::string &blocks, const std::string &xtra);
+};
+
+} // namespace Performance
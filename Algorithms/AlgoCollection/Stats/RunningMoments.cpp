@@ -0,0 +1,121 @@
+#include <cmath>
+
+#include "RunningMoments.h"
+
+namespace Stats
+{
+//
+// Constructors & destructors
+//
+
+RunningMoments::RunningMoments(uint64_t m)
+        : count(m, 0),
+          mean(m, 0.0),
+          m2(m, 0.0)
+{ }
+
+//
+// API
+//
+
+void RunningMoments::push(const arma::mat &mx, uint64_t i)
+{
+    if (locked)
+    {
+        return;
+    }
+    
+    for (uint64_t j = 0; j < mx.n_cols; ++j)
+    {
+        double x = mx.at(i, j);
+        
+        if (std::isnan(x))
+        {
+            continue;
+        }
+        
+        ++count[j];
+        double d = x - mean[j];
+        mean[j] += d / (double)count[j];
+        m2[j] += d * (x - mean[j]);
+    }
+}
+
+double RunningMoments::getMean(uint64_t j) const
+{
+    return mean[j];
+}
+
+double RunningMoments::getStddev(uint64_t j) const
+{
+    double stddev = count[j] > 1 ? std::sqrt(m2[j] / (double)(count[j] - 1)) : 0.0;
+    return stddev > 0.0 ? stddev : 1.0;
+}
+
+void RunningMoments::normalizeRow(arma::mat &mx, uint64_t i) const
+{
+    for (uint64_t j = 0; j < mx.n_cols; ++j)
+    {
+        if (!std::isnan(mx.at(i, j)))
+        {
+            mx.at(i, j) = (mx.at(i, j) - mean[j]) / getStddev(j);
+        }
+    }
+}
+
+void RunningMoments::denormalizeRow(arma::mat &mx, uint64_t i) const
+{
+    for (uint64_t j = 0; j < mx.n_cols; ++j)
+    {
+        mx.at(i, j) = mx.at(i, j) * getStddev(j) + mean[j];
+    }
+}
+
+void RunningMoments::normalizeRows(arma::mat &mx, uint64_t rows) const
+{
+    for (uint64_t j = 0; j < mx.n_cols; ++j)
+    {
+        double *column = mx.colptr(j);
+        double stddev = getStddev(j);
+        
+        for (uint64_t i = 0; i < rows; ++i)
+        {
+            if (!std::isnan(column[i]))
+            {
+                column[i] = (column[i] - mean[j]) / stddev;
+            }
+        }
+    }
+}
+
+void RunningMoments::denormalizeRows(arma::mat &mx, uint64_t rows) const
+{
+    for (uint64_t j = 0; j < mx.n_cols; ++j)
+    {
+        double *column = mx.colptr(j);
+        double stddev = getStddev(j);
+        
+        for (uint64_t i = 0; i < rows; ++i)
+        {
+            column[i] = column[i] * stddev + mean[j];
+        }
+    }
+}
+
+void RunningMoments::saveState(MathIO::CheckpointWriter &writer) const
+{
+    writer.write(count);
+    writer.write(mean);
+    writer.write(m2);
+    writer.write((uint64_t)locked);
+}
+
+void RunningMoments::loadState(MathIO::CheckpointReader &reader)
+{
+    reader.read(count);
+    reader.read(mean);
+    reader.read(m2);
+    locked = reader.readWord() != 0;
+}
+
+} // namespace Stats
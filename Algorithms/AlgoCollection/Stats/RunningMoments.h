@@ -0,0 +1,60 @@
+#include <vector>
+#include <armadillo>
+
+#include "../MathIO/Checkpoint.h"
+
+#pragma once
+
+namespace Stats
+{
+
+// Mean and standard deviation of every column, updated one row at a time (Welford), NaN entries are not counted.
+// Once locked, new rows don't change them anymore.
+class RunningMoments
+{
+    //
+    // Data
+    //
+  private:
+    std::vector<uint64_t> count;
+    std::vector<double> mean;
+    std::vector<double> m2;
+  
+  public:
+    bool locked = false;
+    
+    //
+    // Constructors & destructors
+    //
+  public:
+    explicit RunningMoments(uint64_t m);
+    
+    //
+    // API
+    //
+  public:
+    // O(m)
+    void push(const arma::mat &mx, uint64_t i);
+    
+    double getMean(uint64_t j) const;
+    
+    // 1 while there is not enough data, so a column is never scaled by 0
+    double getStddev(uint64_t j) const;
+    
+    // observed entries of row i are replaced by (x - mean) / stddev
+    void normalizeRow(arma::mat &mx, uint64_t i) const;
+    
+    // back into the original scale, missing entries stay NaN
+    void denormalizeRow(arma::mat &mx, uint64_t i) const;
+    
+    // the same for rows [0, rows), a column at a time; O(rows * m), but one square root per column and contiguous
+    void normalizeRows(arma::mat &mx, uint64_t rows) const;
+    
+    void denormalizeRows(arma::mat &mx, uint64_t rows) const;
+    
+    void saveState(MathIO::CheckpointWriter &writer) const;
+    
+    void loadState(MathIO::CheckpointReader &reader);
+};
+
+} // namespace Stats
@@ -2,15 +2,41 @@
 // Created by Zakhar on 07.03.2017.
 //
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
 #include <string>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include "Testing.h"
 #include "Algebra/CentroidDecomposition.h"
+#include "Algebra/GrowingMatrix.h"
+#include "Algebra/MissingIndex.h"
+#include "Algebra/Kernels.h"
+#include "Algebra/SignVector.h"
 #include "Algorithms/CDMissingValueRecovery.h"
+#include "Algorithms/SignVectorPolicy.h"
+#include "Algorithms/TKCM.h"
+#include "Algorithms/SPIRIT.h"
+#include "Algorithms/GROUSE.h"
+#include "Algorithms/OGDImpute.h"
+#include "Algorithms/PCA_MME.h"
+#include "Algorithms/PartitionedRecovery.h"
 #include "Stats/Correlation.h"
 #include "Algebra/Auxiliary.h"
 #include "Algebra/RSVD.h"
+#include "MathIO/MatrixReadWrite.h"
+#include "Performance/Benchmark.h"
+#include "Performance/Server.h"
 
 #include <armadillo>
 
@@ -131,146 +157,1921 @@ void TestCD_RMV()
 
 namespace DataSets
 {
-std::vector<std::vector<double>> example1 = {
-        {-5.63, -1.58, -6.57},
-        {-3.37, -0.20, -3.92},
-        {-0.82, 4.07,  1.45}
+// two smooth latent series mixed into m columns, no noise on top
+arma::mat synth_streaming(uint64_t n, uint64_t m)
+{
+    arma::mat mx(n, m);
     
-};
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        double t = (double)i / 10.0;
+        double s1 = std::sin(t);
+        double s2 = std::cos(0.37 * t) + 0.5 * std::sin(0.11 * t);
+        
+        for (uint64_t j = 0; j < m; ++j)
+        {
+            double w = (double)(j + 1);
+            mx.at(i, j) = std::cos(w) * s1 + std::sin(0.7 * w) * s2 + 0.1 * w;
+        }
+    }
+    
+    return mx;
+}
 
-std::vector<std::vector<double>> example1full = {
-        {-5.63, -1.58, -6.57},
-        {-3.37, -0.20, -3.92},
-        {-0.82, 4.07,  1.45},
-        // example1 ^
-        {-1.00, -0.02, -4.77},
-        {-2.28, -1.60, -3.63},
-        {-2.35, 0.20,  -3.18},
-        {-1.37, 4.47,  1.68},
-        {-5.05, 0.48,  -5.27},
-        {-5.43, -1.23, -7.45},
-        {-4.82, 0.52,  -4.90},
-        {-4.20, 4.77,  -0.55},
-        {-5.07, 0.75,  -5.88}
-};
+// same, plus deterministic noise uniform in [-noise / 2, noise / 2)
+arma::mat synth_streaming(uint64_t n, uint64_t m, double noise)
+{
+    arma::mat mx = synth_streaming(n, m);
+    
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        for (uint64_t j = 0; j < m; ++j)
+        {
+            double hash = std::sin((double)(i * m + j + 1)) * 43758.5453;
+            mx.at(i, j) += (hash - std::floor(hash) - 0.5) * noise;
+        }
+    }
+    
+    return mx;
+}
+}
 
-std::vector<std::vector<double>> example1full_ext = {
-        {-5.63, -1.58, -6.57, 2.98},
-        {-3.37, -0.20, -3.92, -4.01},
-        {-0.82, 4.07,  1.45,  3.11},
-        // example1 ^
-        {-1.00, -0.02, -4.77, 1.11},
-        {-2.28, -1.60, -3.63, -2.22},
-        {-2.35, 0.20,  -3.18, -1.01},
-        {-1.37, 4.47,  1.68,  -0.10},
-        {-5.05, 0.48,  -5.27, 0.86},
-        {-5.43, -1.23, -7.45, 1.08},
-        {-4.82, 0.52,  -4.90, 2.45},
-        {-4.20, 4.77,  -0.55, -0.51},
-        {-5.07, 0.75,  -5.88, -1.41}
-};
+void TestStreamingCD()
+{
+    const uint64_t n = 400, m = 8, history = 320;
+    const double tolerance = 1E-3;
+    
+    arma::mat reference = DataSets::synth_streaming(n, m);
+    arma::mat incomplete(reference);
+    
+    // missing blocks: one at the tail of the stream, one inside of it
+    for (uint64_t i = 340; i < n; ++i)
+    {
+        incomplete.at(i, 0) = NAN;
+    }
+    for (uint64_t i = 360; i < 380; ++i)
+    {
+        incomplete.at(i, 3) = NAN;
+    }
+    
+    // batch
+    arma::mat batch(incomplete);
+    CDMissingValueRecovery batchRecovery(batch, 100, 1E-6);
+    batchRecovery.setReduction(3);
+    batchRecovery.autoDetectMissingBlocks();
+    batchRecovery.performRecovery();
+    
+    // streaming, rows after history are revealed and imputed one at a time
+    arma::mat stream = incomplete.submat(arma::span(0, history - 1), arma::span::all);
+    CDMissingValueRecovery streamRecovery(stream, 100, 1E-6);
+    streamRecovery.setReduction(3);
+    streamRecovery.autoDetectMissingBlocks();
+    streamRecovery.performRecovery();
+    
+    streamRecovery.increment_raw(n - history);
+    
+    for (uint64_t i = history; i < n; ++i)
+    {
+        for (uint64_t j = 0; j < m; ++j)
+        {
+            stream.at(i, j) = incomplete.at(i, j);
+        }
+        streamRecovery.performStreamingRecovery(1);
+    }
+    
+    double maxDiff = 0.0, rmseBatch = 0.0, rmseStream = 0.0;
+    uint64_t count = 0;
+    
+    for (uint64_t j = 0; j < m; ++j)
+    {
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            if (std::isnan(incomplete.at(i, j)))
+            {
+                maxDiff = std::max(maxDiff, fabs(batch.at(i, j) - stream.at(i, j)));
+                rmseBatch += std::pow(batch.at(i, j) - reference.at(i, j), 2);
+                rmseStream += std::pow(stream.at(i, j) - reference.at(i, j), 2);
+                ++count;
+            }
+        }
+    }
+    
+    std::cout << "RMSE(batch) = " << std::sqrt(rmseBatch / (double)count) << std::endl
+              << "RMSE(stream) = " << std::sqrt(rmseStream / (double)count) << std::endl
+              << "max|batch - stream| = " << maxDiff << " (tolerance " << tolerance << ")" << std::endl;
+    
+    if (maxDiff > tolerance)
+    {
+        throw std::runtime_error("[TestStreamingCD] streaming recovery diverges from batch recovery");
+    }
 }
 
-void TestIncCD()
+void TestParallelLSV()
 {
-    arma::mat mx = Algebra::Operations::std_to_arma(DataSets::example1); // the same one changed by inc. algo
+    const uint64_t n = 600, m = 10, threads = 4;
+    const double tolerance = 1E-9;
     
-    mx.print("X =");
+    // noise makes the search flip rows after the first one in many sweeps
+    arma::mat matrix = DataSets::synth_streaming(n, m, 1.0);
     
-    CentroidDecomposition cd(mx);
+    arma::mat serialMatrix(matrix), parallelMatrix(matrix);
     
-    cd.performDecomposition();
+    CentroidDecomposition serial(serialMatrix);
+    serial.performDecomposition();
+    serial.resetSignVectors(); // the second run starts from {+1}^n instead of the greedy init
+    serial.performDecomposition();
     
-    const arma::mat &L = cd.getLoad();
-    const arma::mat &R = cd.getRel();
+    CentroidDecomposition parallel(parallelMatrix);
+    parallel.threads = threads;
+    parallel.performDecomposition();
+    parallel.resetSignVectors();
+    parallel.performDecomposition();
     
-    L.print("LOAD =");
-    R.print("REL =");
+    bool same = serial.getFlips() == parallel.getFlips();
     
-    arma::mat reconstructedX = L * R.t();
+    for (uint64_t k = 0; k < m; ++k)
+    {
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            same = same && serial.signVectors[k][i] == parallel.signVectors[k][i];
+        }
+    }
     
-    reconstructedX -= mx;
+    double maxDiff = arma::abs(serial.getLoad() - parallel.getLoad()).max();
+    maxDiff = std::max(maxDiff, arma::abs(serial.getRel() - parallel.getRel()).max());
     
-    std::cout << "||X - (L * R^T)||_F = " << arma::norm(reconstructedX, "fro") << std::endl;
+    // the deflation sums in a different order with threads, only the sign vectors are exactly the same
+    std::cout << "flips(1 thread) = " << serial.getFlips() << ", flips(" << threads << " threads) = "
+              << parallel.getFlips() << std::endl
+              << "max|L, R (1 thread) - L, R (" << threads << " threads)| = " << maxDiff
+              << " (tolerance " << tolerance << ")" << std::endl;
     
-    for (uint64_t data3iter = 3; data3iter < DataSets::example1full.size(); ++data3iter)
+    if (!same || maxDiff > tolerance)
     {
-        cd.increment(DataSets::example1full[data3iter]);
-        
-        cd.performDecomposition();
-        
-        const arma::mat &L2 = cd.getLoad();
-        const arma::mat &R2 = cd.getRel();
-        
-        reconstructedX = L2 * R2.t();
+        throw std::runtime_error("[TestParallelLSV] the parallel search differs from the serial one");
+    }
+}
+
+void TestImplicitDeflation()
+{
+    const uint64_t n = 400, m = 8;
+    const double tolerance = 1E-9;
+    
+    arma::mat matrix = DataSets::synth_streaming(n, m, 1.0);
+    
+    arma::mat explicitMatrix(matrix), implicitMatrix(matrix);
+    
+    CentroidDecomposition explicitCD(explicitMatrix);
+    explicitCD.performDecomposition();
+    explicitCD.resetSignVectors();
+    explicitCD.performDecomposition();
+    
+    CentroidDecomposition implicitCD(implicitMatrix);
+    implicitCD.implicitDeflation = true;
+    implicitCD.performDecomposition();
+    implicitCD.resetSignVectors();
+    implicitCD.performDecomposition();
+    
+    bool same = explicitCD.getFlips() == implicitCD.getFlips();
+    
+    for (uint64_t k = 0; k < m; ++k)
+    {
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            same = same && explicitCD.signVectors[k][i] == implicitCD.signVectors[k][i];
+        }
+    }
+    
+    double maxDiff = arma::abs(explicitCD.getLoad() - implicitCD.getLoad()).max();
+    maxDiff = std::max(maxDiff, arma::abs(explicitCD.getRel() - implicitCD.getRel()).max());
+    
+    std::cout << "flips(explicit) = " << explicitCD.getFlips() << ", flips(implicit) = " << implicitCD.getFlips()
+              << std::endl
+              << "max|L, R (explicit) - L, R (implicit)| = " << maxDiff << " (tolerance " << tolerance << ")"
+              << std::endl;
+    
+    if (!same || maxDiff > tolerance)
+    {
+        throw std::runtime_error("[TestImplicitDeflation] implicit deflation differs from the explicit one");
+    }
+}
+
+void TestGramCache()
+{
+    const uint64_t n = 300, m = 8;
+    const double tolerance = 1E-9;
+    
+    arma::mat matrix = DataSets::synth_streaming(n, m, 1.0);
+    
+    bool same = true;
+    double maxDiff = 0.0;
+    
+    for (CDSignVectorStrategy_2 strategy : { CDSignVectorStrategy_2::ISSVBase, CDSignVectorStrategy_2::ISSVPlusBase })
+    {
+        // the whole Gram matrix, a part of it, none
+        std::vector<std::unique_ptr<CentroidDecomposition>> decompositions;
+        std::vector<arma::mat> copies(3, matrix);
+        const uint64_t budgets[] = { n * n * sizeof(double), n * n * sizeof(double) / 3, 0 };
         
-        reconstructedX -= mx;
+        for (uint64_t c = 0; c < 3; ++c)
+        {
+            decompositions.emplace_back(new CentroidDecomposition(copies[c]));
+            decompositions[c]->strategy = strategy;
+            decompositions[c]->gramCacheBytes = budgets[c];
+            decompositions[c]->performDecomposition();
+        }
         
-        std::cout << "Incremental iteration #" << data3iter << std::endl;
-        std::cout << "||X - (L * R^T)||_F = " << arma::norm(reconstructedX, "fro") << std::endl;
+        for (uint64_t c = 0; c < 2; ++c)
+        {
+            for (uint64_t k = 0; k < m; ++k)
+            {
+                for (uint64_t i = 0; i < n; ++i)
+                {
+                    same = same && decompositions[c]->signVectors[k][i] == decompositions[2]->signVectors[k][i];
+                }
+            }
+            
+            maxDiff = std::max(maxDiff, arma::abs(decompositions[c]->getLoad() - decompositions[2]->getLoad()).max());
+        }
     }
     
-    std::cout << "INC:" << std::endl;
-    cd.getLoad().print();
-    cd.getRel().print();
+    std::cout << "ISSV, ISSV+ with a full, a partial and no Gram cache: "
+              << (same ? "same sign vectors" : "sign vectors differ") << std::endl
+              << "max|L (cached) - L (uncached)| = " << maxDiff << " (tolerance " << tolerance << ")" << std::endl;
     
-    arma::mat mx3 = Algebra::Operations::std_to_arma(DataSets::example1full);
-    Algorithms::CentroidDecomposition cd2(mx3);
+    if (!same || maxDiff > tolerance)
+    {
+        throw std::runtime_error("[TestGramCache] the Gram cache changes the sign vectors");
+    }
+}
+
+void TestSearchBudget()
+{
+    const uint64_t n = 300, m = 8, maxFlips = 20, maxSweeps = 2;
     
-    cd2.resetSignVectors();
-    cd2.performDecomposition();
+    arma::mat matrix = DataSets::synth_streaming(n, m, 1.0);
     
-    std::cout << "Batch:" << std::endl;
-    cd2.getLoad().print();
-    cd2.getRel().print();
+    // a single decomposition stops at the budget
+    arma::mat unboundedMatrix(matrix), flipsMatrix(matrix), sweepsMatrix(matrix);
     
-    arma::mat diff = (cd2.getLoad() - cd.getLoad());
-    std::cout << "||L - L_i||_F = " << arma::norm(diff, "fro") << std::endl;
+    CentroidDecomposition unbounded(unboundedMatrix);
+    unbounded.performDecomposition();
     
-    diff = (cd2.getRel() - cd.getRel());
-    std::cout << "||R - R_i||_F = " << arma::norm(diff, "fro") << std::endl;
+    CentroidDecomposition flipsBound(flipsMatrix);
+    flipsBound.maxFlips = maxFlips;
+    flipsBound.performDecomposition();
+    
+    CentroidDecomposition sweepsBound(sweepsMatrix);
+    sweepsBound.maxSweeps = maxSweeps;
+    sweepsBound.performDecomposition();
+    
+    // the recovery goes on with the truncated searches
+    arma::mat incomplete(matrix);
+    
+    for (uint64_t i = 100; i < 140; ++i)
+    {
+        incomplete.at(i, 2) = NAN;
+    }
+    
+    CDMissingValueRecovery recovery(incomplete, 100, 1E-6);
+    recovery.setReduction(3);
+    recovery.setSearchBudget(0, maxFlips, 0);
+    recovery.autoDetectMissingBlocks();
+    recovery.performRecovery();
+    
+    std::cout << "flips: unbounded " << unbounded.getFlips() << ", max-flips=" << maxFlips << " "
+              << flipsBound.getFlips() << ", max-sweeps=" << maxSweeps << " " << sweepsBound.getFlips() << std::endl
+              << "truncated searches in the recovery: " << recovery.getTruncatedSearches() << std::endl;
+    
+    if (unbounded.searchTruncated || !flipsBound.searchTruncated || !sweepsBound.searchTruncated
+        || flipsBound.getFlips() > maxFlips || sweepsBound.getFlips() >= unbounded.getFlips())
+    {
+        throw std::runtime_error("[TestSearchBudget] the sign vector search doesn't keep to its budget");
+    }
+    
+    if (recovery.getTruncatedSearches() == 0 || !incomplete.is_finite())
+    {
+        throw std::runtime_error("[TestSearchBudget] the recovery with a search budget fails");
+    }
 }
 
-void TestCD()
+void TestAnderson()
 {
-    arma::mat mx = Algebra::Operations::std_to_arma(DataSets::example1);
-    arma::mat mx2(mx);
+    const uint64_t n = 400, m = 8;
+    const double tolerance = 1E-5;
     
-    mx.print("X =");
+    arma::mat reference = DataSets::synth_streaming(n, m);
+    arma::mat plain(reference);
     
-    CentroidDecomposition cd(mx2);
+    for (uint64_t i = 100; i < 160; ++i)
+    {
+        plain.at(i, 0) = NAN;
+    }
+    for (uint64_t i = 250; i < 300; ++i)
+    {
+        plain.at(i, 5) = NAN;
+    }
     
-    cd.performDecomposition();
+    arma::mat accelerated(plain);
     
-    const arma::mat &L = cd.getLoad();
-    const arma::mat &R = cd.getRel();
+    CDMissingValueRecovery plainRecovery(plain, 1000, 1E-8);
+    plainRecovery.setReduction(3);
+    plainRecovery.autoDetectMissingBlocks();
+    uint64_t plainIterations = plainRecovery.performRecovery();
     
-    L.print("LOAD =");
-    R.print("REL =");
+    CDMissingValueRecovery acceleratedRecovery(accelerated, 1000, 1E-8);
+    acceleratedRecovery.setReduction(3);
+    acceleratedRecovery.acceleration = 5;
+    acceleratedRecovery.autoDetectMissingBlocks();
+    uint64_t acceleratedIterations = acceleratedRecovery.performRecovery();
     
-    arma::mat reconstructedX = L * R.t();
-    reconstructedX.print("L * R^T =");
+    double maxDiff = arma::abs(plain - accelerated).max();
     
-    reconstructedX -= mx;
-    std::cout << "||X - (L * R^T)||_F = " << arma::norm(reconstructedX, "fro") << std::endl;
+    std::cout << "iterations: plain " << plainIterations << ", anderson " << acceleratedIterations << std::endl
+              << "max|plain - anderson| = " << maxDiff << " (tolerance " << tolerance << ")" << std::endl;
+    
+    if (!accelerated.is_finite() || maxDiff > tolerance)
+    {
+        throw std::runtime_error("[TestAnderson] Anderson mixing doesn't reach the fixed point of the plain iteration");
+    }
 }
 
-namespace DataSets
+void TestSignVectorPolicy()
 {
-std::vector<std::vector<double>> testdata1 = {
-        {2,  -1, 7},
-        {8,  6,  -4},
-        {-3, -2, 1}
+    bool valid = true;
+    SignVectorPolicy policy;
     
-};
+    // names and their parameters
+    valid = valid && SignVectorPolicy::parse("cached", policy) && policy.schedule == SignVectorSchedule::Cached;
+    valid = valid && SignVectorPolicy::parse("skip-after:3", policy)
+            && policy.schedule == SignVectorSchedule::SkipAfter && policy.count == 3 && policy.fresh;
+    valid = valid && SignVectorPolicy::parse("skip-after-keep:3", policy)
+            && policy.schedule == SignVectorSchedule::SkipAfter && policy.count == 3 && !policy.fresh;
+    valid = valid && SignVectorPolicy::parse("skip-converged:0.5", policy)
+            && policy.schedule == SignVectorSchedule::SkipConverged && policy.threshold == 0.5;
+    valid = valid && SignVectorPolicy::parse("alternate", policy)
+            && policy.schedule == SignVectorSchedule::Alternate && policy.count == 3;
+    valid = valid && SignVectorPolicy::parse("reset-at:1:4:7", policy)
+            && policy.schedule == SignVectorSchedule::ResetAt
+            && policy.iterations == std::vector<uint64_t>({ 1, 4, 7 });
+    valid = valid && SignVectorPolicy::parse("adaptive:1:2", policy)
+            && policy.schedule == SignVectorSchedule::Adaptive && policy.stableFlips == 1 && policy.maxSkips == 2;
+    
+    for (const char *name : { "", "bogus", "cached:1", "skip-after", "skip-after:x", "reset-first-keep:2", "search-at",
+                              "adaptive:1:2:3" })
+    {
+        valid = valid && !SignVectorPolicy::parse(name, policy);
+    }
+    
+    // adaptive:0:2 - a search without flips is skipped while delta goes down, at most 2 times in a row
+    SignVectorPolicy::parse("adaptive:0:2", policy);
+    policy.restart();
+    
+    const double deltas[] = { 99.0, 1.0, 0.5, 0.25, 0.1, 0.2, 0.1 };
+    const uint64_t flips[] = { 0, 0, 0, 5, 0, 0, 0 };
+    const std::string expected = "SKKSSSK";
+    std::string schedule;
+    
+    for (uint64_t iter = 1; iter <= expected.size(); ++iter)
+    {
+        SignVectorStep step = policy.next(iter, deltas[iter - 1]);
+        policy.observe(step.search ? flips[iter - 1] : 0);
+        schedule += step.search ? 'S' : 'K';
+        valid = valid && !step.reset;
+    }
+    
+    std::cout << "policy names: " << (valid ? "parsed as expected" : "not parsed as expected") << std::endl
+              << "adaptive:0:2 schedule = " << schedule << " (expected " << expected << "), skipped "
+              << policy.skippedSearches << std::endl;
+    
+    if (!valid || schedule != expected || policy.skippedSearches != 3)
+    {
+        throw std::runtime_error("[TestSignVectorPolicy] policies aren't parsed or scheduled as expected");
+    }
+}
 
-std::vector<std::vector<double>> testdata2 = {
-        {2,  -2},
-        {0,  3},
-        {-4, 2}
-};
+void TestPipeOptions()
+{
+    const uint64_t n = 300, m = 8, history = 200;
+    std::string path = "TestPipe.txt";
+    
+    // columns on different scales, so the normalization shows
+    arma::mat input = DataSets::synth_streaming(n, m, 0.01);
+    
+    for (uint64_t j = 0; j < m; ++j)
+    {
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            input.at(i, j) = input.at(i, j) * (double)(j + 1) + 10.0 * (double)j;
+        }
+    }
+    for (uint64_t i = 60; i < 80; ++i)
+    {
+        input.at(i, 2) = NAN;
+    }
+    for (uint64_t i = history; i < n; i += 4)
+    {
+        input.at(i, 0) = NAN;
+    }
+    
+    {
+        std::ofstream file(path);
+        
+        for (uint64_t i = history; i < n; ++i)
+        {
+            MathIO::exportRow(file, input.row(i).t());
+        }
+    }
+    
+    // the pipe with the options and without them...
+    std::ostringstream configured, plain;
+    
+    for (std::ostringstream *out : { &configured, &plain })
+    {
+        arma::mat warm = input.submat(arma::span(0, history - 1), arma::span::all);
+        MathIO::MatrixReader reader(path, ' ');
+        Performance::RecoveryPipe(warm, reader, *out, nullptr, 3, "cd",
+                                  out == &configured ? "foldin,normalize,refresh=20" : "");
+    }
+    
+    // ...and the imputer set up by hand, on the same rows as the pipe reads them
+    std::ostringstream expected;
+    arma::mat warm = input.submat(arma::span(0, history - 1), arma::span::all);
+    CDStreamingImputer imputer(3);
+    CDMissingValueRecovery &rmv = imputer.prepare(warm);
+    rmv.foldIn = true;
+    rmv.persistentNormalization = true;
+    rmv.refreshInterval = 20;
+    rmv.issueCorrections = false;
+    imputer.warmUp(warm);
+    
+    for (uint64_t i = 0; i < history; ++i)
+    {
+        MathIO::exportRow(expected, warm.row(i).t());
+    }
+    
+    MathIO::MatrixReader reader(path, ' ');
+    arma::vec row;
+    
+    while (reader.hasNextLine() && reader.readNextRow(m, row))
+    {
+        imputer.pushRow(row);
+        MathIO::exportRow(expected, row);
+    }
+    
+    std::remove(path.c_str());
+    
+    std::string written = configured.str();
+    
+    std::cout << "rows written: " << std::count(written.begin(), written.end(), '\n')
+              << ", refreshes: " << rmv.getRefreshes() << std::endl;
+    
+    if (written != expected.str() || written == plain.str())
+    {
+        throw std::runtime_error("[TestPipeOptions] the pipe doesn't recover with the options it's given");
+    }
+}
 
-std::vector<double> vector1 = {1.4, -2.0, 0.7};
+void TestRefreshStream()
+{
+    const uint64_t n = 400, m = 8, history = 200, interval = 25;
+    
+    // columns on different scales, so rows normalized with the wrong statistics show
+    arma::mat reference = DataSets::synth_streaming(n, m, 0.01);
+    
+    for (uint64_t j = 0; j < m; ++j)
+    {
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            reference.at(i, j) = reference.at(i, j) * (double)(j + 1) + 10.0 * (double)j;
+        }
+    }
+    
+    arma::mat input = reference;
+    
+    for (uint64_t i = 50; i < 70; ++i)
+    {
+        input.at(i, 3) = NAN;
+    }
+    for (uint64_t i = history; i < n; i += 4)
+    {
+        input.at(i, 0) = NAN;
+    }
+    
+    // the stream is allocated up front and filled row by row, as the row streaming benchmark does it...
+    arma::mat allocated = input.submat(arma::span(0, history - 1), arma::span::all);
+    CDMissingValueRecovery upfront(allocated, 100, 1E-6);
+    
+    // ...or the matrix grows with every row, rows that haven't arrived don't exist
+    arma::mat grown = allocated;
+    CDMissingValueRecovery growing(grown, 100, 1E-6);
+    
+    for (CDMissingValueRecovery *recovery : { &upfront, &growing })
+    {
+        recovery->setReduction(3);
+        recovery->persistentNormalization = true;
+        recovery->refreshInterval = interval;
+        recovery->autoDetectMissingBlocks();
+        recovery->performRecovery();
+    }
+    
+    upfront.increment_raw(n - history);
+    
+    for (uint64_t i = history; i < n; ++i)
+    {
+        allocated.row(i) = input.row(i);
+        upfront.performStreamingRecovery(1);
+        
+        growing.increment(arma::vec(input.row(i).t()));
+        growing.performStreamingRecovery(1);
+    }
+    
+    double maxDiff = arma::abs(allocated - grown).max();
+    
+    std::cout << "refreshes = " << upfront.getRefreshes() << std::endl
+              << "max|allocated - grown| = " << maxDiff << " (tolerance 1e-09)" << std::endl;
+    
+    if (upfront.getRefreshes() < (n - history) / interval)
+    {
+        throw std::runtime_error("[TestRefreshStream] the decomposition isn't refreshed on schedule");
+    }
+    
+    if (!allocated.is_finite() || maxDiff > 1E-9)
+    {
+        throw std::runtime_error("[TestRefreshStream] rows that haven't arrived take part in the refresh");
+    }
+}
+
+void TestWindowIndex()
+{
+    const uint64_t capacity = 100, n = capacity + 3 * capacity, m = 6;
+    
+    arma::mat input = DataSets::synth_streaming(n, m, 0.01);
+    
+    // missing cells in the history and in every third pushed row
+    for (uint64_t i = 20; i < 40; ++i)
+    {
+        input.at(i, 1) = NAN;
+    }
+    for (uint64_t i = capacity; i < n; i += 3)
+    {
+        input.at(i, i % m) = NAN;
+    }
+    
+    arma::mat window = input.submat(arma::span(0, capacity - 1), arma::span::all);
+    CDMissingValueRecovery recovery(window, 100, 1E-6);
+    recovery.setReduction(3);
+    recovery.autoDetectMissingBlocks();
+    recovery.performRecovery();
+    recovery.setWindow(capacity);
+    
+    uint64_t maxRuns = 0, maxChanged = 0;
+    
+    for (uint64_t i = capacity; i < n; ++i)
+    {
+        recovery.pushRow(input.row(i).t());
+        maxRuns = std::max(maxRuns, recovery.getMissingIndex().runs());
+        maxChanged = std::max(maxChanged, recovery.getMissingIndex().changedRows());
+    }
+    
+    const Algebra::MissingIndex &index = recovery.getMissingIndex();
+    
+    std::cout << "after " << n - capacity << " pushes: runs = " << index.runs() << " (max " << maxRuns
+              << "), rows to rescan = " << index.changedRows() << " (max " << maxChanged << ")" << std::endl;
+    
+    // the history's runs leave with its rows, every slot waits for the next scan once
+    if (maxChanged > capacity || maxRuns > 1 || index.runs() != 0 || !window.is_finite())
+    {
+        throw std::runtime_error("[TestWindowIndex] the missing index grows with the stream");
+    }
+    
+    // the next scan looks at each slot once and finds nothing, the pushed rows are recovered
+    recovery.autoDetectMissingBlocks();
+    
+    if (index.changedRows() != 0 || index.runs() != 0)
+    {
+        throw std::runtime_error("[TestWindowIndex] recovered rows are found missing again");
+    }
+}
+
+void TestGrowingMatrix()
+{
+    const uint64_t n = 300, m = 5;
+    
+    arma::mat expected(n, m);
+    Algebra::GrowingMatrix matrix(m);
+    uint64_t reallocations = 0;
+    
+    // rows of both kinds and a run of constant ones, past several doublings of the capacity
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        uint64_t capacity = matrix.capacity();
+        
+        if (i % 50 == 40)
+        {
+            matrix.appendRows(10, (double)i);
+            expected.rows(i, i + 9).fill((double)i);
+            i += 9;
+        }
+        else if (i % 2 == 0)
+        {
+            std::vector<double> row(m);
+            
+            for (uint64_t j = 0; j < m; ++j)
+            {
+                row[j] = std::sin((double)(i * m + j));
+                expected.at(i, j) = row[j];
+            }
+            matrix.appendRow(row);
+        }
+        else
+        {
+            arma::vec row(m);
+            
+            for (uint64_t j = 0; j < m; ++j)
+            {
+                row[j] = std::cos((double)(i * m + j));
+                expected.at(i, j) = row[j];
+            }
+            matrix.appendRow(row);
+        }
+        
+        if (matrix.capacity() != capacity)
+        {
+            ++reallocations;
+        }
+    }
+    
+    arma::mat result = matrix.toMatrix();
+    bool sameShape = result.n_rows == n && result.n_cols == m && matrix.n_rows() == n && matrix.n_cols() == m;
+    double maxDiff = sameShape ? arma::abs(result - expected).max() : 1.0;
+    
+    std::cout << "rows: " << matrix.n_rows() << ", capacity: " << matrix.capacity() << ", reallocations: "
+              << reallocations << std::endl
+              << "max|grown - plain| = " << maxDiff << std::endl;
+    
+    if (maxDiff != 0.0)
+    {
+        throw std::runtime_error("[TestGrowingMatrix] the grown matrix differs from the plain one");
+    }
+    
+    if (reallocations < 4 || matrix.capacity() >= 2 * n)
+    {
+        throw std::runtime_error("[TestGrowingMatrix] the capacity doesn't grow geometrically");
+    }
+    
+    if (Algebra::GrowingMatrix(m).toMatrix().n_rows != 0)
+    {
+        throw std::runtime_error("[TestGrowingMatrix] an empty matrix has rows");
+    }
+}
+
+void TestServer()
+{
+    const uint64_t n = 200, m = 6;
+    const std::string socketPath = "TestServer.sock", data = "TestServer.txt", broken = "TestServerBroken.txt";
+    
+    arma::mat reference = DataSets::synth_streaming(n, m, 0.01);
+    
+    MathIO::exportMatrix(data, reference);
+    std::ofstream(broken) << "1 2 3" << std::endl << "4 x 6" << std::endl;
+    
+    // what the command line recovers from the same file
+    std::string input = data;
+    MathIO::MatrixReader reader(input, ' ');
+    arma::mat expected = reader.getFullMatrix();
+    
+    for (uint64_t i = 50; i < 70; ++i)
+    {
+        expected.at(i, 1) = NAN;
+    }
+    (void) Performance::Recovery(expected, 3, "cd", "");
+    
+    Performance::RecoveryServer server(socketPath, 1);
+    
+    if (!server.isValid())
+    {
+        throw std::runtime_error("[TestServer] the socket can't be listened on");
+    }
+    
+    std::thread serving([&server] { server.run(); });
+    
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, socketPath.c_str());
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        throw std::runtime_error("[TestServer] can't connect to the server");
+    }
+    
+    auto receive = [fd](void *data, uint64_t bytes)
+    {
+        char *pos = static_cast<char *>(data);
+        
+        for (ssize_t got = 0; bytes > 0; pos += got, bytes -= static_cast<uint64_t>(got))
+        {
+            if ((got = read(fd, pos, bytes)) <= 0)
+            {
+                throw std::runtime_error("[TestServer] the connection is closed mid-reply");
+            }
+        }
+    };
+    
+    // the status of the reply, an error message is read past
+    auto request = [fd, &receive](const std::string &line)
+    {
+        std::string text = line + "\n";
+        
+        if (write(fd, text.data(), text.size()) != static_cast<ssize_t>(text.size()))
+        {
+            throw std::runtime_error("[TestServer] the request can't be sent");
+        }
+        
+        uint64_t status = 0, length = 0;
+        receive(&status, sizeof(status));
+        
+        if (status != 0)
+        {
+            receive(&length, sizeof(length));
+            std::string message(length, ' ');
+            receive(&message[0], length);
+        }
+        
+        return status;
+    };
+    
+    // a recovery that goes through is read whole, so the replies stay in step
+    auto recover = [&request, &receive](const std::string &line, arma::mat &result)
+    {
+        uint64_t status = request(line);
+        
+        if (status == 0)
+        {
+            uint64_t header[3] = { 0, 0, 0 };
+            receive(header, sizeof(header));
+            result.set_size(header[1], header[2]);
+            receive(result.memptr(), result.n_elem * sizeof(double));
+        }
+        
+        return status;
+    };
+    
+    uint64_t shape[2] = { 0, 0 };
+    uint64_t loaded = request("load data " + data);
+    
+    if (loaded == 0)
+    {
+        receive(shape, sizeof(shape));
+    }
+    
+    // none of these may take the server down or get through
+    arma::mat result;
+    uint64_t unparsed = request("load broken " + broken);
+    uint64_t policy = recover("recover data cd 3 0 0 - policy=none-such", result);
+    uint64_t cluster = recover("recover data cd 3 0 0 - partition=1", result);
+    uint64_t overflow = recover("recover data cd 3 0 0 1:10:18446744073709551610", result);
+    
+    result.reset();
+    uint64_t recovered = recover("recover data cd 3 0 0 1:50:20", result);
+    
+    uint64_t quit = request("quit");
+    close(fd);
+    serving.join();
+    
+    std::remove(data.c_str());
+    std::remove(broken.c_str());
+    
+    bool sameShape = result.n_rows == expected.n_rows && result.n_cols == expected.n_cols;
+    double maxDiff = sameShape ? arma::abs(result - expected).max() : 1.0;
+    
+    std::cout << "load: " << loaded << " [" << shape[0] << "x" << shape[1] << "], unparsable load: " << unparsed
+              << ", bad policy: " << policy << ", bad cluster size: " << cluster << ", overflowing block: " << overflow
+              << std::endl
+              << "max|served - command line| = " << maxDiff << std::endl;
+    
+    if (loaded != 0 || shape[0] != n || shape[1] != m)
+    {
+        throw std::runtime_error("[TestServer] the dataset isn't loaded");
+    }
+    
+    if (unparsed == 0 || policy == 0 || cluster == 0 || overflow == 0)
+    {
+        throw std::runtime_error("[TestServer] an invalid request is accepted");
+    }
+    
+    if (recovered != 0 || quit != 0 || maxDiff > 1E-9)
+    {
+        throw std::runtime_error("[TestServer] the served recovery differs from the command line one");
+    }
+}
+
+void TestRowDeadline()
+{
+    const uint64_t n = 300, m = 8, history = 200;
+    const double tolerance = 1E-6;
+    
+    arma::mat reference = DataSets::synth_streaming(n, m, 0.01);
+    
+    arma::mat input = reference;
+    
+    for (uint64_t i = history; i < n; ++i)
+    {
+        input.at(i, i % m) = NAN;
+        input.at(i, (i + 3) % m) = NAN;
+    }
+    
+    // 1us per row: rows are emitted as fold-in estimates and iterated to the end only by refinePending; Rel isn't
+    // refreshed, so every row has the same fixed point as without a deadline
+    arma::mat plain = input.submat(arma::span(0, history - 1), arma::span::all);
+    arma::mat deadline = plain;
+    arma::mat silent = plain;
+    
+    CDMissingValueRecovery plainRecovery(plain, 1000, 1E-12);
+    CDMissingValueRecovery deadlineRecovery(deadline, 1000, 1E-12);
+    CDMissingValueRecovery silentRecovery(silent, 1000, 1E-12);
+    deadlineRecovery.rowDeadline = 1;
+    silentRecovery.rowDeadline = 1;
+    silentRecovery.issueCorrections = false;
+    
+    for (CDMissingValueRecovery *rmv : { &plainRecovery, &deadlineRecovery, &silentRecovery })
+    {
+        rmv->setReduction(3);
+        rmv->autoDetectMissingBlocks();
+        rmv->performRecovery();
+        rmv->increment_raw(n - history);
+    }
+    
+    std::vector<CorrectionRecord> records;
+    
+    for (uint64_t i = history; i < n; ++i)
+    {
+        plain.row(i) = input.row(i);
+        deadline.row(i) = input.row(i);
+        silent.row(i) = input.row(i);
+        
+        plainRecovery.performStreamingRecovery(1);
+        deadlineRecovery.performStreamingRecovery(1);
+        silentRecovery.performStreamingRecovery(1);
+        
+        for (const CorrectionRecord &c : deadlineRecovery.takeCorrections())
+        {
+            records.push_back(c);
+        }
+    }
+    
+    deadlineRecovery.refinePending();
+    silentRecovery.refinePending();
+    
+    for (const CorrectionRecord &c : deadlineRecovery.takeCorrections())
+    {
+        records.push_back(c);
+    }
+    
+    double maxDeadline = arma::abs(deadline - plain).max();
+    double maxSilent = arma::abs(silent - plain).max();
+    
+    std::cout << "max|deadline + refine - no deadline| = " << (maxDeadline <= tolerance ? "ok" : "FAIL")
+              << ", without correction records " << (maxSilent <= tolerance ? "ok" : "FAIL")
+              << " (tolerance " << tolerance << ")" << std::endl;
+    
+    if (deadlineRecovery.metrics.fallbacks == 0)
+    {
+        throw std::runtime_error("[TestRowDeadline] no row was emitted as an estimate");
+    }
+    
+    if (!deadline.is_finite() || maxDeadline > tolerance || !silent.is_finite() || maxSilent > tolerance)
+    {
+        throw std::runtime_error("[TestRowDeadline] refined rows don't reach the result without a deadline");
+    }
+    
+    if (records.size() != deadlineRecovery.metrics.corrections || !silentRecovery.takeCorrections().empty())
+    {
+        throw std::runtime_error("[TestRowDeadline] correction records don't follow issueCorrections");
+    }
+}
+
+void TestFoldIn()
+{
+    const uint64_t n = 300, m = 8, history = 200;
+    const double tolerance = 1E-9;
+    
+    // rank 3 (two series and the offsets), a decomposition with k = 3 spans every row
+    arma::mat reference = DataSets::synth_streaming(n, m);
+    arma::mat matrix = reference.submat(arma::span(0, history - 1), arma::span::all);
+    
+    CDMissingValueRecovery spanned(matrix);
+    spanned.setReduction(3);
+    spanned.foldIn = true;
+    spanned.autoDetectMissingBlocks();
+    spanned.performRecovery();
+    spanned.increment_raw(n - history);
+    
+    for (uint64_t i = history; i < n; ++i)
+    {
+        matrix.row(i) = reference.row(i);
+        matrix.at(i, 0) = NAN;
+        matrix.at(i, 5) = NAN;
+        spanned.performStreamingRecovery(1);
+    }
+    
+    double maxSpanned = arma::abs(matrix - reference).max();
+    
+    // two equal columns are all the observed ones, R_obs^T * R_obs is singular and the row is iterated instead
+    arma::mat singular(120, 4);
+    
+    for (uint64_t i = 0; i < singular.n_rows; ++i)
+    {
+        double t = (double)i / 10.0;
+        singular.at(i, 0) = std::sin(t) + 2.0;
+        singular.at(i, 1) = singular.at(i, 0);
+        singular.at(i, 2) = std::cos(0.37 * t);
+        singular.at(i, 3) = std::sin(0.11 * t) - std::cos(t);
+    }
+    
+    arma::mat foldedMatrix = singular.submat(arma::span(0, 99), arma::span::all);
+    arma::mat iteratedMatrix = foldedMatrix;
+    
+    CDMissingValueRecovery folded(foldedMatrix);
+    CDMissingValueRecovery iterated(iteratedMatrix);
+    folded.foldIn = true;
+    
+    for (CDMissingValueRecovery *rmv : { &folded, &iterated })
+    {
+        rmv->setReduction(2);
+        rmv->autoDetectMissingBlocks();
+        rmv->performRecovery();
+        rmv->increment_raw(20);
+    }
+    
+    for (uint64_t i = 100; i < 120; ++i)
+    {
+        foldedMatrix.row(i) = singular.row(i);
+        foldedMatrix.at(i, 2) = NAN;
+        foldedMatrix.at(i, 3) = NAN;
+        iteratedMatrix.row(i) = foldedMatrix.row(i);
+        
+        folded.performStreamingRecovery(1);
+        iterated.performStreamingRecovery(1);
+    }
+    
+    double maxFallback = arma::abs(foldedMatrix - iteratedMatrix).max();
+    
+    std::cout << "max|fold-in - reference| (row in span(R)) = " << maxSpanned << " (tolerance " << tolerance << ")"
+              << std::endl
+              << "max|fold-in - fixed point| (singular system) = " << maxFallback << std::endl;
+    
+    if (!matrix.is_finite() || maxSpanned > tolerance)
+    {
+        throw std::runtime_error("[TestFoldIn] a row in the span of the decomposition isn't recovered exactly");
+    }
+    
+    if (!foldedMatrix.is_finite() || maxFallback != 0.0)
+    {
+        throw std::runtime_error("[TestFoldIn] a singular fold-in doesn't fall back to the fixed point");
+    }
+}
+
+void TestCheckpoint()
+{
+    const uint64_t n = 300, m = 8, history = 200, saved = 250;
+    const std::string path = "TestCheckpoint.bin";
+    
+    arma::mat reference = DataSets::synth_streaming(n, m, 0.01);
+    
+    arma::mat input = reference;
+    
+    for (uint64_t i = 80; i < 110; ++i)
+    {
+        input.at(i, 2) = NAN;
+    }
+    for (uint64_t i = history; i < n; i += 3)
+    {
+        input.at(i, 0) = NAN;
+    }
+    
+    // history and a part of the stream, then saved
+    arma::mat matrix = input.submat(arma::span(0, history - 1), arma::span::all);
+    CDMissingValueRecovery original(matrix);
+    original.setReduction(3);
+    original.persistentNormalization = true;
+    original.autoDetectMissingBlocks();
+    original.performRecovery();
+    original.increment_raw(n - history);
+    
+    for (uint64_t i = history; i < saved; ++i)
+    {
+        matrix.row(i) = input.row(i);
+        original.performStreamingRecovery(1);
+    }
+    
+    if (!original.saveCheckpoint(path) || std::ifstream(path + ".tmp").good())
+    {
+        throw std::runtime_error("[TestCheckpoint] the checkpoint can't be written or its temporary file is left");
+    }
+    
+    // loaded into a recovery over a matrix of another size, both go on with the rest of the stream
+    arma::mat restoredMatrix(10, m);
+    restoredMatrix.zeros();
+    CDMissingValueRecovery restored(restoredMatrix);
+    
+    if (!restored.loadCheckpoint(path))
+    {
+        throw std::runtime_error("[TestCheckpoint] the checkpoint can't be read back");
+    }
+    
+    bool sameShape = restoredMatrix.n_rows == n && restoredMatrix.n_cols == m;
+    double maxLoaded = sameShape ? arma::abs(restoredMatrix - matrix).max() : 1.0;
+    
+    for (uint64_t i = saved; sameShape && i < n; ++i)
+    {
+        matrix.row(i) = input.row(i);
+        restoredMatrix.row(i) = input.row(i);
+        original.performStreamingRecovery(1);
+        restored.performStreamingRecovery(1);
+    }
+    
+    double maxStream = sameShape ? arma::abs(restoredMatrix - matrix).max() : 1.0;
+    
+    // a truncated file, one with an unknown strategy and ones with a length word larger than the file (the rows of
+    // the matrix, the pending rows at the end) are rejected, the recovery is left as it was
+    std::vector<char> bytes;
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    
+    arma::mat before = restoredMatrix;
+    uint64_t rejected = 0;
+    
+    for (uint64_t variant = 0; variant < 4; ++variant)
+    {
+        std::vector<char> broken = bytes;
+        uint64_t huge = (uint64_t)1 << 60;
+        
+        if (variant == 0)
+        {
+            broken.resize(broken.size() / 2);
+        }
+        else if (variant == 1)
+        {
+            // signature, version, the matrix, 4 words of the recovery, the truncation, then the strategy
+            uint64_t offset = 8 * (2 + 2 + n * m + 4 + 1);
+            uint64_t unknown = 99;
+            std::memcpy(broken.data() + offset, &unknown, sizeof(unknown));
+        }
+        else if (variant == 2)
+        {
+            std::memcpy(broken.data() + 8 * 2, &huge, sizeof(huge));
+        }
+        else
+        {
+            std::memcpy(broken.data() + broken.size() - sizeof(huge), &huge, sizeof(huge));
+        }
+        
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(broken.data(), (std::streamsize)broken.size());
+        }
+        
+        try
+        {
+            restored.loadCheckpoint(path);
+        }
+        catch (std::runtime_error &e)
+        {
+            std::cout << "rejected: " << e.what() << std::endl;
+            ++rejected;
+        }
+    }
+    
+    std::remove(path.c_str());
+    
+    bool unchanged = restoredMatrix.n_rows == before.n_rows && arma::abs(restoredMatrix - before).max() == 0.0;
+    
+    std::cout << "max|loaded - saved| = " << maxLoaded << std::endl
+              << "max|restored - original| after the stream = " << maxStream << std::endl;
+    
+    if (!sameShape || maxLoaded != 0.0 || maxStream != 0.0)
+    {
+        throw std::runtime_error("[TestCheckpoint] a restored recovery doesn't go on like the saved one");
+    }
+    
+    if (rejected != 4 || !unchanged)
+    {
+        throw std::runtime_error("[TestCheckpoint] a broken checkpoint isn't rejected or changes the recovery");
+    }
+}
+
+void TestPartitionedRecovery()
+{
+    const uint64_t n = 300, m = 8;
+    const double tolerance = 1E-9;
+    
+    arma::mat matrix = DataSets::synth_streaming(n, m, 0.01);
+    
+    for (uint64_t i = 50; i < 90; ++i)
+    {
+        matrix.at(i, 1) = NAN;
+    }
+    for (uint64_t i = 200; i < 240; ++i)
+    {
+        matrix.at(i, 5) = NAN;
+    }
+    
+    arma::mat full(matrix);
+    const arma::mat input(matrix);
+    
+    // a cluster as wide as the matrix is the full recovery
+    PartitionedRecovery partitioned(matrix);
+    partitioned.k = 3;
+    partitioned.clusterSize = m;
+    partitioned.performRecovery();
+    
+    CDMissingValueRecovery fullRecovery(full);
+    fullRecovery.setReduction(3);
+    fullRecovery.autoDetectMissingBlocks();
+    fullRecovery.performRecovery();
+    
+    double maxFirst = arma::abs(matrix - full).max();
+    
+    // the same object again, a column that was complete the first time isn't anymore
+    for (uint64_t i = 120; i < 150; ++i)
+    {
+        matrix.at(i, 3) = NAN;
+        full.at(i, 3) = NAN;
+    }
+    
+    partitioned.performRecovery();
+    
+    CDMissingValueRecovery secondRecovery(full);
+    secondRecovery.setReduction(3);
+    secondRecovery.autoDetectMissingBlocks();
+    secondRecovery.performRecovery();
+    
+    double maxSecond = arma::abs(matrix - full).max();
+    
+    std::cout << "clusters = " << partitioned.clusters.size() << std::endl
+              << "max|partitioned - full| = " << maxFirst << ", after more cells went missing "
+              << maxSecond << " (tolerance " << tolerance << ")" << std::endl;
+    
+    if (!matrix.is_finite())
+    {
+        throw std::runtime_error("[TestPartitionedRecovery] cells that went missing later are left unrecovered");
+    }
+    
+    if (maxFirst > tolerance || maxSecond > tolerance)
+    {
+        throw std::runtime_error("[TestPartitionedRecovery] a cluster of all the columns diverges from the full recovery");
+    }
+    
+    // m - 1 references: every incomplete column is recovered together with all the others
+    arma::mat referenced(input);
+    full = input;
+    
+    PartitionedRecovery byReferences(referenced);
+    byReferences.k = 3;
+    byReferences.references = m - 1;
+    byReferences.performRecovery();
+    
+    CDMissingValueRecovery thirdRecovery(full);
+    thirdRecovery.setReduction(3);
+    thirdRecovery.autoDetectMissingBlocks();
+    thirdRecovery.performRecovery();
+    
+    double maxReferences = arma::abs(referenced - full).max();
+    
+    std::cout << "clusters (m - 1 references) = " << byReferences.clusters.size() << std::endl
+              << "max|references - full| = " << maxReferences << " (tolerance " << tolerance << ")" << std::endl;
+    
+    if (!referenced.is_finite() || maxReferences > tolerance)
+    {
+        throw std::runtime_error("[TestPartitionedRecovery] m - 1 references diverge from the full recovery");
+    }
+}
+
+void TestReductionCache()
+{
+    const uint64_t n = 300, m = 8;
+    
+    // two latent series and a little noise
+    arma::mat matrix = DataSets::synth_streaming(n, m, 0.01);
+    
+    for (uint64_t i = 100; i < 130; ++i)
+    {
+        matrix.at(i, 0) = NAN;
+    }
+    
+    arma::mat uncachedMatrix(matrix);
+    
+    CDMissingValueRecovery cached(matrix, 100, 1E-6);
+    cached.reductionDrift = 0.1;
+    cached.autoDetectMissingBlocks();
+    cached.performRecovery(true);
+    uint64_t first = cached.getReduction();
+    
+    CDMissingValueRecovery uncached(uncachedMatrix, 100, 1E-6);
+    uncached.reductionDrift = 0.0;
+    uncached.autoDetectMissingBlocks();
+    uncached.performRecovery(true);
+    
+    // the first latent series is taken out: the leading centroid hardly moves, the ones behind it do
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        for (uint64_t j = 0; j < m; ++j)
+        {
+            double s1 = std::sin((double)i / 10.0) * std::cos((double)(j + 1));
+            matrix.at(i, j) -= s1;
+            uncachedMatrix.at(i, j) -= s1;
+        }
+    }
+    
+    cached.performRecovery(true);
+    uncached.performRecovery(true);
+    
+    std::cout << "k: first " << first << ", after the change: cached " << cached.getReduction()
+              << ", detected " << uncached.getReduction() << std::endl;
+    
+    if (cached.getReduction() != uncached.getReduction())
+    {
+        throw std::runtime_error("[TestReductionCache] a cached reduction is kept after the spectrum changed");
+    }
+}
+
+void TestPersistentNormalization()
+{
+    const uint64_t n = 400, m = 8, history = 300;
+    const double tolerance = 1E-2;
+    
+    // columns on different scales, so a recovery that mixes normalized and raw values shows
+    arma::mat reference = DataSets::synth_streaming(n, m);
+    
+    for (uint64_t j = 0; j < m; ++j)
+    {
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            reference.at(i, j) = reference.at(i, j) * (double)(j + 1) * 10.0 + 100.0 * (double)j;
+        }
+    }
+    
+    arma::mat input = reference;
+    
+    for (uint64_t i = 100; i < 130; ++i)
+    {
+        input.at(i, 1) = NAN;
+    }
+    
+    for (uint64_t i = history; i < n; i += 7)
+    {
+        input.at(i, 0) = NAN;
+    }
+    
+    // statistics of the whole history vs the running ones
+    arma::mat batch = input.submat(arma::span(0, history - 1), arma::span::all);
+    CDMissingValueRecovery batchRecovery(batch, 100, 1E-6);
+    batchRecovery.setReduction(3);
+    batchRecovery.useNormalization = true;
+    batchRecovery.autoDetectMissingBlocks();
+    batchRecovery.performRecovery();
+    
+    arma::mat matrix = input.submat(arma::span(0, history - 1), arma::span::all);
+    CDMissingValueRecovery recovery(matrix, 100, 1E-6);
+    recovery.setReduction(3);
+    recovery.persistentNormalization = true;
+    recovery.autoDetectMissingBlocks();
+    recovery.performRecovery();
+    
+    double maxBatch = 0.0;
+    
+    for (uint64_t i = 0; i < history; ++i)
+    {
+        maxBatch = std::max(maxBatch, fabs(matrix.at(i, 1) - batch.at(i, 1)) / 20.0);
+    }
+    
+    // the statistics stop following the stream, its rows are recovered in the original scale
+    recovery.lockNormalization();
+    double lockedMean = recovery.getMoments().getMean(0);
+    
+    recovery.increment_raw(n - history);
+    
+    for (uint64_t i = history; i < n; ++i)
+    {
+        for (uint64_t j = 0; j < m; ++j)
+        {
+            matrix.at(i, j) = input.at(i, j);
+        }
+        
+        recovery.performStreamingRecovery(1);
+    }
+    
+    // the caller's copy gets the recovered cells, nothing else
+    arma::mat exported = input;
+    recovery.exportRecovered(exported);
+    
+    double maxObserved = 0.0, maxExported = 0.0, maxStream = 0.0;
+    
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        for (uint64_t j = 0; j < m; ++j)
+        {
+            maxExported = std::max(maxExported, fabs(exported.at(i, j) - matrix.at(i, j)));
+            
+            if (!std::isnan(input.at(i, j)))
+            {
+                maxObserved = std::max(maxObserved, fabs(matrix.at(i, j) - input.at(i, j)));
+            }
+            else if (i >= history)
+            {
+                maxStream = std::max(maxStream, fabs(matrix.at(i, j) - reference.at(i, j)) / 10.0);
+            }
+        }
+    }
+    
+    std::cout << "max|persistent - batch| / scale = " << maxBatch << " (tolerance " << tolerance << ")" << std::endl
+              << "max|streamed - reference| / scale = " << maxStream << " (tolerance " << tolerance << ")" << std::endl
+              << "max|observed - input| = " << maxObserved << std::endl
+              << "max|exported - matrix| = " << maxExported << std::endl;
+    
+    if (maxObserved > 1E-9 || !exported.is_finite() || maxExported > 1E-9)
+    {
+        throw std::runtime_error("[TestPersistentNormalization] the matrix isn't in the original scale between calls");
+    }
+    
+    if (recovery.getMoments().getMean(0) != lockedMean)
+    {
+        throw std::runtime_error("[TestPersistentNormalization] locked statistics follow the stream");
+    }
+    
+    if (maxBatch > tolerance || maxStream > tolerance)
+    {
+        throw std::runtime_error("[TestPersistentNormalization] running statistics recover worse than batch ones");
+    }
+}
+
+void TestScanFrontier()
+{
+    const uint64_t n = 90, m = 4;
+    
+    arma::mat matrix = DataSets::synth_streaming(n, m);
+    
+    // blocks over the borders of the appends (30 and 60), at the tail and next to each other in one column
+    for (uint64_t i = 25; i < 36; ++i)
+    {
+        matrix.at(i, 0) = NAN;
+    }
+    for (uint64_t i = 58; i < 62; ++i)
+    {
+        matrix.at(i, 2) = NAN;
+    }
+    for (uint64_t i = 80; i < n; ++i)
+    {
+        matrix.at(i, 3) = NAN;
+    }
+    matrix.at(5, 1) = NAN;
+    matrix.at(7, 1) = NAN;
+    matrix.at(29, 1) = NAN;
+    matrix.at(30, 1) = NAN;
+    
+    Algebra::MissingIndex full;
+    full.scan(matrix);
+    
+    Algebra::MissingIndex appended;
+    
+    for (uint64_t rows = 30; rows <= n; rows += 30)
+    {
+        arma::mat part = matrix.submat(arma::span(0, rows - 1), arma::span::all);
+        appended.scan(part);
+    }
+    
+    auto runsOf = [](const Algebra::MissingIndex &index)
+    {
+        std::vector<std::vector<uint64_t>> runs;
+        
+        for (uint64_t r = 0; r < index.runs(); ++r)
+        {
+            runs.push_back({ index.column(r), index.start(r), index.size(r) });
+        }
+        
+        std::sort(runs.begin(), runs.end());
+        return runs;
+    };
+    
+    std::cout << "runs(full) = " << full.runs() << ", cells(full) = " << full.cells() << std::endl
+              << "runs(3 appends) = " << appended.runs() << ", cells(3 appends) = " << appended.cells() << std::endl;
+    
+    if (runsOf(full) != runsOf(appended) || full.cells() != appended.cells() || appended.scannedRows() != n)
+    {
+        throw std::runtime_error("[TestScanFrontier] scanning appended rows differs from a full scan");
+    }
+}
+
+void TestRescanCD()
+{
+    const uint64_t n = 300, m = 8;
+    const double tolerance = 1E-3;
+    
+    arma::mat reference = DataSets::synth_streaming(n, m);
+    arma::mat matrix(reference);
+    
+    for (uint64_t i = 10; i < 20; ++i)
+    {
+        matrix.at(i, 1) = NAN;
+    }
+    
+    CDMissingValueRecovery recovery(matrix, 100, 1E-6);
+    recovery.setReduction(3);
+    recovery.autoDetectMissingBlocks();
+    recovery.performRecovery();
+    
+    // the object is reused: new missing values in rows that were scanned already
+    for (uint64_t i = 50; i < 60; ++i)
+    {
+        matrix.at(i, 4) = NAN;
+    }
+    
+    arma::mat fresh(matrix);
+    
+    recovery.rescanRows(50, 10);
+    recovery.autoDetectMissingBlocks();
+    recovery.performRecovery();
+    
+    CDMissingValueRecovery freshRecovery(fresh, 100, 1E-6);
+    freshRecovery.setReduction(3);
+    freshRecovery.autoDetectMissingBlocks();
+    freshRecovery.performRecovery();
+    
+    double maxDiff = 0.0;
+    bool finite = matrix.is_finite();
+    
+    for (uint64_t i = 50; i < 60; ++i)
+    {
+        maxDiff = std::max(maxDiff, fabs(matrix.at(i, 4) - fresh.at(i, 4)));
+    }
+    
+    // detected missing cells whose slots are overwritten by observed rows before the recovery, and a missing cell in
+    // a slot that was overwritten after the scan
+    recovery.setWindow(n);
+    
+    for (uint64_t i = 10; i < 20; ++i)
+    {
+        matrix.at(i, 1) = NAN;
+    }
+    recovery.rescanRows(10, 10);
+    recovery.autoDetectMissingBlocks();
+    
+    for (uint64_t i = 0; i < 20; ++i)
+    {
+        recovery.pushRow(reference.row(i).t() + 1.0);
+    }
+    
+    matrix.at(3, 6) = NAN;
+    recovery.autoDetectMissingBlocks();
+    recovery.performRecovery();
+    
+    // the recovery puts the window in arrival order, the pushed rows are the newest ones
+    double maxObserved = 0.0;
+    finite = finite && matrix.is_finite();
+    
+    for (uint64_t i = 10; i < 20; ++i)
+    {
+        maxObserved = std::max(maxObserved, fabs(matrix.at(n - 20 + i, 1) - reference.at(i, 1) - 1.0));
+    }
+    
+    std::cout << "max|reused - fresh| = " << maxDiff << " (tolerance " << tolerance << ")" << std::endl
+              << "max|overwritten - observed| = " << maxObserved << std::endl;
+    
+    if (!finite || maxDiff > tolerance)
+    {
+        throw std::runtime_error("[TestRescanCD] rows changed after the scan aren't recovered");
+    }
+    
+    if (maxObserved > 1E-9)
+    {
+        throw std::runtime_error("[TestRescanCD] cells of an overwritten row are recovered again");
+    }
+}
+
+void TestWindowCD()
+{
+    const uint64_t n = 450, m = 8, capacity = 200;
+    const double tolerance = 1E-3;
+    
+    arma::mat reference = DataSets::synth_streaming(n, m);
+    
+    // complete history, 250 more rows go through the window: it turned over once, its head is at slot 50
+    arma::mat window = reference.submat(arma::span(0, capacity - 1), arma::span::all);
+    CDMissingValueRecovery windowRecovery(window, 100, 1E-6);
+    windowRecovery.setReduction(3);
+    windowRecovery.autoDetectMissingBlocks();
+    windowRecovery.performRecovery();
+    windowRecovery.setWindow(capacity);
+    
+    for (uint64_t i = capacity; i < n; ++i)
+    {
+        windowRecovery.pushRow(reference.row(i).t());
+    }
+    
+    // a block over the seam of the ring: slots 45..54 are the 5 newest rows and the 5 oldest ones
+    for (uint64_t s = 45; s < 55; ++s)
+    {
+        window.at(s, 2) = NAN;
+    }
+    
+    windowRecovery.autoDetectMissingBlocks();
+    windowRecovery.performRecovery();
+    
+    // the same rows in arrival order, recovered from scratch
+    const uint64_t first = n - capacity;
+    arma::mat batch = reference.submat(arma::span(first, n - 1), arma::span::all);
+    
+    for (uint64_t i = 0; i < 5; ++i)
+    {
+        batch.at(i, 2) = NAN;
+        batch.at(capacity - 1 - i, 2) = NAN;
+    }
+    
+    CDMissingValueRecovery batchRecovery(batch, 100, 1E-6);
+    batchRecovery.setReduction(3);
+    batchRecovery.autoDetectMissingBlocks();
+    batchRecovery.performRecovery();
+    
+    double maxDiff = 0.0, maxObserved = 0.0;
+    
+    for (uint64_t i = 0; i < capacity; ++i)
+    {
+        for (uint64_t j = 0; j < m; ++j)
+        {
+            maxDiff = std::max(maxDiff, fabs(window.at(i, j) - batch.at(i, j)));
+            
+            if (j != 2 || (i >= 5 && i < capacity - 5))
+            {
+                maxObserved = std::max(maxObserved, fabs(window.at(i, j) - reference.at(first + i, j)));
+            }
+        }
+    }
+    
+    std::cout << "refreshes = " << windowRecovery.getRefreshes() << std::endl
+              << "max|window - batch| = " << maxDiff << " (tolerance " << tolerance << ")" << std::endl
+              << "max|window - observed| = " << maxObserved << std::endl;
+    
+    if (windowRecovery.getRefreshes() == 0)
+    {
+        throw std::runtime_error("[TestWindowCD] the window wasn't refreshed after it turned over");
+    }
+    
+    if (maxObserved != 0.0)
+    {
+        throw std::runtime_error("[TestWindowCD] the window isn't in arrival order");
+    }
+    
+    if (!window.is_finite() || maxDiff > tolerance)
+    {
+        throw std::runtime_error("[TestWindowCD] recovery over the window diverges from batch recovery");
+    }
+}
+
+void TestStreamingImputers()
+{
+    const uint64_t n = 400, m = 8, history = 320;
+    
+    arma::mat reference = DataSets::synth_streaming(n, m);
+    arma::mat incomplete(reference);
+    
+    // a block in the history, one in column 0 of the stream and one in a reference column of TKCM
+    for (uint64_t i = 100; i < 110; ++i)
+    {
+        incomplete.at(i, 1) = NAN;
+    }
+    for (uint64_t i = 340; i < 360; ++i)
+    {
+        incomplete.at(i, 0) = NAN;
+    }
+    for (uint64_t i = 350; i < 355; ++i)
+    {
+        incomplete.at(i, 2) = NAN;
+    }
+    
+    // error bound: twice the spread of the reference values, the imputations have to stay finite and in range
+    const double bound = 2.0 * arma::stddev(arma::vectorise(reference));
+    
+    std::vector<std::pair<std::string, std::unique_ptr<StreamingImputer>>> imputers;
+    imputers.emplace_back("ORBITS", std::unique_ptr<StreamingImputer>(new CDStreamingImputer(3, 1)));
+    imputers.emplace_back("TKCM", std::unique_ptr<StreamingImputer>(new TKCMStreamingImputer()));
+    imputers.emplace_back("SPIRIT", std::unique_ptr<StreamingImputer>(new SPIRITStreamingImputer(3, 6, 1.0)));
+    imputers.emplace_back("OGDImpute", std::unique_ptr<StreamingImputer>(new OGDStreamingImputer(3)));
+    imputers.emplace_back("SAGE", std::unique_ptr<StreamingImputer>(new SAGEStreamingImputer(3)));
+    imputers.emplace_back("PCA-MME", std::unique_ptr<StreamingImputer>(new PCAMMEStreamingImputer(3)));
+    
+    for (auto &imputer : imputers)
+    {
+        arma::mat recovered = incomplete.submat(arma::span(0, history - 1), arma::span::all);
+        imputer.second->warmUp(recovered);
+        recovered.resize(n, m);
+        
+        arma::vec row(m);
+        
+        for (uint64_t i = history; i < n; ++i)
+        {
+            for (uint64_t j = 0; j < m; ++j)
+            {
+                row[j] = incomplete.at(i, j);
+            }
+            
+            imputer.second->pushRow(row);
+            
+            for (uint64_t j = 0; j < m; ++j)
+            {
+                recovered.at(i, j) = row[j];
+            }
+        }
+        
+        double rmse = 0.0;
+        uint64_t count = 0;
+        
+        for (uint64_t j = 0; j < m; ++j)
+        {
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                if (std::isnan(incomplete.at(i, j)))
+                {
+                    rmse += std::pow(recovered.at(i, j) - reference.at(i, j), 2);
+                    ++count;
+                }
+            }
+        }
+        rmse = std::sqrt(rmse / (double)count);
+        
+        std::cout << "RMSE(" << imputer.first << ") = " << rmse << " (bound " << bound << ")" << std::endl;
+        
+        if (!std::isfinite(rmse) || rmse > bound)
+        {
+            throw std::runtime_error("[TestStreamingImputers] " + imputer.first + " doesn't recover the stream");
+        }
+    }
+}
+
+namespace DataSets
+{
+std::vector<std::vector<double>> example1 = {
+        {-5.63, -1.58, -6.57},
+        {-3.37, -0.20, -3.92},
+        {-0.82, 4.07,  1.45}
+
+};
+
+std::vector<std::vector<double>> example1full = {
+        {-5.63, -1.58, -6.57},
+        {-3.37, -0.20, -3.92},
+        {-0.82, 4.07,  1.45},
+        // example1 ^
+        {-1.00, -0.02, -4.77},
+        {-2.28, -1.60, -3.63},
+        {-2.35, 0.20,  -3.18},
+        {-1.37, 4.47,  1.68},
+        {-5.05, 0.48,  -5.27},
+        {-5.43, -1.23, -7.45},
+        {-4.82, 0.52,  -4.90},
+        {-4.20, 4.77,  -0.55},
+        {-5.07, 0.75,  -5.88}
+};
+
+std::vector<std::vector<double>> example1full_ext = {
+        {-5.63, -1.58, -6.57, 2.98},
+        {-3.37, -0.20, -3.92, -4.01},
+        {-0.82, 4.07,  1.45,  3.11},
+        // example1 ^
+        {-1.00, -0.02, -4.77, 1.11},
+        {-2.28, -1.60, -3.63, -2.22},
+        {-2.35, 0.20,  -3.18, -1.01},
+        {-1.37, 4.47,  1.68,  -0.10},
+        {-5.05, 0.48,  -5.27, 0.86},
+        {-5.43, -1.23, -7.45, 1.08},
+        {-4.82, 0.52,  -4.90, 2.45},
+        {-4.20, 4.77,  -0.55, -0.51},
+        {-5.07, 0.75,  -5.88, -1.41}
+};
+}
+
+void TestIncCD()
+{
+    arma::mat mx = Algebra::Operations::std_to_arma(DataSets::example1); // the same one changed by inc. algo
+    
+    mx.print("X =");
+    
+    CentroidDecomposition cd(mx);
+    
+    cd.performDecomposition();
+    
+    const arma::mat &L = cd.getLoad();
+    const arma::mat &R = cd.getRel();
+    
+    L.print("LOAD =");
+    R.print("REL =");
+    
+    arma::mat reconstructedX = L * R.t();
+    
+    reconstructedX -= mx;
+    
+    std::cout << "||X - (L * R^T)||_F = " << arma::norm(reconstructedX, "fro") << std::endl;
+    
+    for (uint64_t data3iter = 3; data3iter < DataSets::example1full.size(); ++data3iter)
+    {
+        cd.increment(DataSets::example1full[data3iter]);
+        
+        cd.performDecomposition();
+        
+        const arma::mat &L2 = cd.getLoad();
+        const arma::mat &R2 = cd.getRel();
+        
+        reconstructedX = L2 * R2.t();
+        
+        reconstructedX -= mx;
+        
+        std::cout << "Incremental iteration #" << data3iter << std::endl;
+        std::cout << "||X - (L * R^T)||_F = " << arma::norm(reconstructedX, "fro") << std::endl;
+    }
+    
+    std::cout << "INC:" << std::endl;
+    cd.getLoad().print();
+    cd.getRel().print();
+    
+    arma::mat mx3 = Algebra::Operations::std_to_arma(DataSets::example1full);
+    Algorithms::CentroidDecomposition cd2(mx3);
+    
+    cd2.resetSignVectors();
+    cd2.performDecomposition();
+    
+    std::cout << "Batch:" << std::endl;
+    cd2.getLoad().print();
+    cd2.getRel().print();
+    
+    arma::mat diff = (cd2.getLoad() - cd.getLoad());
+    std::cout << "||L - L_i||_F = " << arma::norm(diff, "fro") << std::endl;
+    
+    diff = (cd2.getRel() - cd.getRel());
+    std::cout << "||R - R_i||_F = " << arma::norm(diff, "fro") << std::endl;
+}
+
+void TestCD()
+{
+    arma::mat mx = Algebra::Operations::std_to_arma(DataSets::example1);
+    arma::mat mx2(mx);
+    
+    mx.print("X =");
+    
+    CentroidDecomposition cd(mx2);
+    
+    cd.performDecomposition();
+    
+    const arma::mat &L = cd.getLoad();
+    const arma::mat &R = cd.getRel();
+    
+    L.print("LOAD =");
+    R.print("REL =");
+    
+    arma::mat reconstructedX = L * R.t();
+    reconstructedX.print("L * R^T =");
+    
+    reconstructedX -= mx;
+    std::cout << "||X - (L * R^T)||_F = " << arma::norm(reconstructedX, "fro") << std::endl;
+}
+
+namespace DataSets
+{
+std::vector<std::vector<double>> testdata1 = {
+        {2,  -1, 7},
+        {8,  6,  -4},
+        {-3, -2, 1}
+
+};
+
+std::vector<std::vector<double>> testdata2 = {
+        {2,  -2},
+        {0,  3},
+        {-4, 2}
+};
+
+std::vector<double> vector1 = {1.4, -2.0, 0.7};
+}
+
+void TestKernels()
+{
+    const uint64_t length = 67, offsets = 3;
+    const double tolerance = 1E-12;
+    
+    arma::vec x(length + offsets), y(length + offsets);
+    
+    for (uint64_t i = 0; i < length + offsets; ++i)
+    {
+        x[i] = std::sin((double)(i + 1));
+        y[i] = std::cos(0.3 * (double)i) * 10.0;
+    }
+    
+    double maxDot = 0.0, maxAxpy = 0.0;
+    
+    // every tail length of the vector loops, at aligned and unaligned starts
+    for (uint64_t off = 0; off < offsets; ++off)
+    {
+        for (uint64_t n = 0; n <= length; ++n)
+        {
+            const double *px = x.memptr() + off;
+            double reference = 0.0, scale = 0.0;
+            
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                reference += px[i] * y[off + i];
+                scale += fabs(px[i] * y[off + i]);
+            }
+            
+            double dot = Algebra::Kernels::dot(px, y.memptr() + off, n);
+            maxDot = std::max(maxDot, fabs(dot - reference) / std::max(scale, 1.0));
+            
+            arma::vec z(y);
+            Algebra::Kernels::axpy(-0.75, px, z.memptr() + off, n);
+            
+            for (uint64_t i = 0; i < length + offsets; ++i)
+            {
+                double expected = i >= off && i < off + n ? y[i] - 0.75 * x[i] : y[i];
+                maxAxpy = std::max(maxAxpy, fabs(z[i] - expected));
+            }
+        }
+    }
+    
+    std::cout << "kernels: " << Algebra::Kernels::isa() << std::endl
+              << "max|dot - scalar| = " << maxDot << " (relative, tolerance " << tolerance << ")" << std::endl
+              << "max|axpy - scalar| = " << maxAxpy << " (tolerance " << tolerance << ")" << std::endl;
+    
+    if (maxDot > tolerance || maxAxpy > tolerance)
+    {
+        throw std::runtime_error("[TestKernels] kernels differ from the scalar loops");
+    }
+}
+
+void TestSignVector()
+{
+    const uint64_t length = 200, extra = 70;
+    const double tolerance = 1E-12;
+    
+    arma::vec v(length + extra);
+    
+    for (uint64_t i = 0; i < length + extra; ++i)
+    {
+        v[i] = std::sin((double)(i + 1)) * 10.0;
+    }
+    
+    bool same = true;
+    double maxDot = 0.0;
+    
+    // every length around the word borders, the reference is a plain vector of +-1
+    for (uint64_t n = 0; n <= length; ++n)
+    {
+        Algebra::SignVector z(n);
+        arma::vec reference(n + extra);
+        reference.ones();
+        
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            double sign = std::cos(3.7 * (double)(i * i + n)) > 0.0 ? 1.0 : -1.0;
+            z.set(i, sign);
+            reference[i] = sign;
+        }
+        
+        for (uint64_t i = 0; i < n; i += 3)
+        {
+            z.flip(i);
+            reference[i] = -reference[i];
+        }
+        
+        z.append(extra); // new entries are +1, whatever the spare bits of the last word were
+        
+        double dot = z.dot(v.memptr()), scalar = 0.0, plain = 0.0, scale = 0.0;
+        
+        for (uint64_t i = 0; i < n + extra; ++i)
+        {
+            same = same && z[i] == reference[i];
+            scalar += reference[i] * v[i];
+            plain += v[i];
+            scale += fabs(v[i]);
+        }
+        
+        same = same && z.size() == n + extra && arma::abs(z.toVector() - reference).max() == 0.0;
+        maxDot = std::max(maxDot, fabs(dot - scalar) / scale);
+        
+        z.reset();
+        maxDot = std::max(maxDot, fabs(z.dot(v.memptr()) - plain) / scale);
+    }
+    
+    std::cout << "sign vectors of 0.." << length << " (+" << extra << ") entries: "
+              << (same ? "same as +-1 vectors" : "differ from +-1 vectors") << std::endl
+              << "max|<z, v> - scalar| = " << maxDot << " (relative, tolerance " << tolerance << ")" << std::endl;
+    
+    if (!same || maxDot > tolerance)
+    {
+        throw std::runtime_error("[TestSignVector] the packed sign vector differs from a vector of +-1");
+    }
 }
 
 void TestBasicOps()
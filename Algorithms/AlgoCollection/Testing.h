@@ -18,8 +18,56 @@ void TestCD_RMV();
 
 void TestIncCD();
 
+void TestStreamingCD();
+
+void TestStreamingImputers();
+
+void TestParallelLSV();
+
+void TestImplicitDeflation();
+
+void TestGramCache();
+
+void TestSearchBudget();
+
+void TestAnderson();
+
+void TestSignVectorPolicy();
+
+void TestPipeOptions();
+
+void TestRefreshStream();
+
+void TestWindowIndex();
+
+void TestGrowingMatrix();
+
+void TestServer();
+
+void TestRowDeadline();
+
+void TestFoldIn();
+
+void TestCheckpoint();
+
+void TestPartitionedRecovery();
+
+void TestReductionCache();
+
+void TestPersistentNormalization();
+
+void TestScanFrontier();
+
+void TestRescanCD();
+
+void TestWindowCD();
+
 void TestCD();
 
+void TestKernels();
+
+void TestSignVector();
+
 void TestBasicOps();
 
 void TestBasicActions();
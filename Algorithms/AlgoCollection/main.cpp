@@ -3,16 +3,13 @@
 #include <chrono>
 
 #include "Performance/Benchmark.h"
+#include "Performance/Server.h"
 #include "Testing.h"
 #include "MathIO/CommandLine.hpp"
 #include "MathIO/MatrixReadWrite.h"
 
 using namespace std;
 
-/* TODO[]
- * - persistent normalization for inc. recovery (lockable manually)
- */
-
 int main(int argc, char *argv[])
 {
     // test suite
@@ -23,10 +20,58 @@ int main(int argc, char *argv[])
         cout << endl << "---=========---" << endl << endl;
         Testing::TestBasicOps();
         cout << endl << "---=========---" << endl << endl;
+        Testing::TestKernels();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestSignVector();
+        cout << endl << "---=========---" << endl << endl;
         Testing::TestCD();
         cout << endl << "---=========---" << endl << endl;
         Testing::TestIncCD();
         cout << endl << "---=========---" << endl << endl;
+        Testing::TestStreamingCD();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestStreamingImputers();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestParallelLSV();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestImplicitDeflation();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestGramCache();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestSearchBudget();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestAnderson();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestSignVectorPolicy();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestPipeOptions();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestRefreshStream();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestWindowIndex();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestGrowingMatrix();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestServer();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestRowDeadline();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestFoldIn();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestCheckpoint();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestPartitionedRecovery();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestReductionCache();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestPersistentNormalization();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestScanFrontier();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestRescanCD();
+        cout << endl << "---=========---" << endl << endl;
+        Testing::TestWindowCD();
+        cout << endl << "---=========---" << endl << endl;
         Testing::TestCorr();
         cout << endl << "---=========---" << endl << endl;
         Testing::TestCD_RMV();
@@ -43,12 +88,13 @@ int main(int argc, char *argv[])
     std::string xtra;
     
     uint64_t n = 0, m = 0, k = 0;
+    uint64_t threads = 1;
     
     int cliret = CommandLine2(
             argc, argv,
             test, algoCode,
             input, output, xtra,
-            n, m, k
+            n, m, k, threads
     );
     
     #if false
@@ -73,6 +119,101 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
     
+    if (test == PTestType::Server)
+    {
+        if (input.empty())
+        {
+            std::cout << "Socket path (-in) is not specified" << std::endl;
+            printUsage();
+            return EXIT_FAILURE;
+        }
+        
+        Performance::RecoveryServer server(input, threads);
+        
+        if (!server.isValid())
+        {
+            return EXIT_FAILURE;
+        }
+        
+        server.run();
+        return EXIT_SUCCESS;
+    }
+    
+    if (test == PTestType::Stream)
+    {
+        if (n == 0)
+        {
+            std::cout << "Amount of rows to warm-up on (-n) is not specified" << std::endl;
+            printUsage();
+            return EXIT_FAILURE;
+        }
+        
+        if (input.empty() || input == "-")
+        {
+            input = "/dev/stdin";
+        }
+        
+        MathIO::MatrixReader reader(input, ' ');
+        
+        if (!reader.isValid())
+        {
+            return EXIT_FAILURE;
+        }
+        
+        // stdout only carries the rows, whatever else is printed goes to stderr
+        std::ostream rows(std::cout.rdbuf());
+        std::cout.rdbuf(std::cerr.rdbuf());
+        
+        // the first row that reads fixes m if it's not given, blank or malformed lines are skipped
+        arma::mat history;
+        arma::vec row;
+        uint64_t warm = 0;
+        
+        while (warm < n && reader.hasNextLine())
+        {
+            if (!reader.readNextRow(m, row))
+            {
+                std::cout << "Skipped a line that isn't a row of " << (m > 0 ? std::to_string(m) + " " : "")
+                          << "numbers" << std::endl;
+                continue;
+            }
+            
+            if (warm == 0)
+            {
+                m = row.n_elem;
+                history.set_size(n, m);
+            }
+            history.row(warm++) = row.t();
+        }
+        
+        if (warm < n)
+        {
+            std::cout << "Input has " << warm << " rows, " << n << " are needed to warm-up on (-n)" << std::endl;
+            std::cout.rdbuf(rows.rdbuf());
+            return EXIT_FAILURE;
+        }
+        
+        if (k > m)
+        {
+            std::cout << "Truncation factor k can't be larger than m" << std::endl;
+            std::cout.rdbuf(rows.rdbuf());
+            return EXIT_FAILURE;
+        }
+        
+        std::ofstream latency;
+        
+        if (!output.empty())
+        {
+            latency.open(output, std::ios::out);
+        }
+        
+        (void) Performance::RecoveryPipe(history, reader, rows, output.empty() ? nullptr : &latency,
+                                         k == 0 ? m : k, algoCode, xtra, threads);
+        
+        std::cout.rdbuf(rows.rdbuf());
+        return EXIT_SUCCESS;
+    }
+    
     if (input.empty() || output.empty())
     {
         std::cout << "Input or output are not specified" << std::endl;
@@ -129,13 +270,13 @@ int main(int argc, char *argv[])
     
     if (test == PTestType::Runtime)
     {
-        recov_res = Performance::Recovery(matrix, k, algoCode, xtra);
+        recov_res = Performance::Recovery(matrix, k, algoCode, xtra, threads);
         
         MathIO::exportSingleValue(output, recov_res);
     }
     else if (test == PTestType::Output)
     {
-        (void) Performance::Recovery(matrix, k, algoCode, xtra);
+        (void) Performance::Recovery(matrix, k, algoCode, xtra, threads);
         
         MathIO::exportMatrix(output, matrix);
     }